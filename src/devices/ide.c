@@ -1,14 +1,20 @@
 #include "devices/ide.h"
 #include <ctype.h>
 #include <debug.h>
+#include <list.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
 #include "devices/partition.h"
 #include "devices/timer.h"
+#include "threads/cpu.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -34,6 +40,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +56,83 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA with retries. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA with retries. */
+
+/* Most sectors a single READ/WRITE SECTOR command can transfer.
+   A sector count of 0 in the command means this many. */
+#define MAX_SECTORS_PER_CMD 256
+
+/* Bus-master IDE register offsets from a channel's bm_base.
+   See the Intel PIIX3 datasheet, section 2.7. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* Bus-master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start/stop transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus-master Status Register bits. */
+#define BM_STA_ACTIVE 0x01      /* Transfer in progress. */
+#define BM_STA_ERR 0x02         /* Error (write 1 to clear). */
+#define BM_STA_INTR 0x04        /* Interrupt (write 1 to clear). */
+
+/* A physical region descriptor, one entry in the table that
+   tells the bus master where in memory to move data to or from.
+   A region may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address of region. */
+    uint16_t size;              /* Size in bytes; 0 means 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* PCI configuration space access.
+   See the PCI Local Bus Specification, section 3.2.2.3.2. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* -dma: Use bus-master DMA when the controller supports it? */
+bool ide_dma;
+
+/* I/O scheduling policies, which decide the order in which a
+   channel serves queued requests. */
+enum io_sched
+  {
+    IOSCHED_FIFO,               /* Arrival order. */
+    IOSCHED_CLOOK,              /* Ascending sectors, wrapping around. */
+    IOSCHED_DEADLINE,           /* C-LOOK, but expired requests first. */
+    IOSCHED_CNT
+  };
+
+static const char *io_sched_names[IOSCHED_CNT] = {"fifo", "clook", "deadline"};
+
+/* -iosched: Scheduling policy in use. */
+static enum io_sched io_sched = IOSCHED_DEADLINE;
+
+/* Ticks a queued read or write may wait under the deadline
+   policy before it is served ahead of the elevator order. */
+#define READ_EXPIRE (TIMER_FREQ / 2)
+#define WRITE_EXPIRE (5 * TIMER_FREQ)
+
+/* Most queued requests merged into one command. */
+#define MAX_MERGE 32
+
+/* A queued read or write of at most MAX_SECTORS_PER_CMD
+   sectors. */
+struct io_request
+  {
+    struct list_elem elem;      /* Element in channel's queue. */
+    struct ata_disk *disk;      /* Disk to access. */
+    block_sector_t sec_no;      /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* Data, CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                 /* True to write, false to read. */
+    int64_t deadline;           /* Tick by which to serve request. */
+    struct semaphore done;      /* Up'd once request is complete. */
+  };
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +141,16 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+
+    /* Statistics. */
+    unsigned long long dma_bytes;   /* Bytes moved by DMA. */
+    unsigned long long pio_bytes;   /* Bytes moved by PIO. */
+    unsigned long long cmd_cnt;     /* Read and write commands issued. */
+    uint64_t cmd_cycles;            /* Total cycles from issue to done. */
+    uint64_t max_cmd_cycles;        /* Slowest command, in cycles. */
+    unsigned long long request_cnt; /* Requests queued. */
+    unsigned long long merge_cnt;   /* Requests merged into another's
+                                       command. */
   };
 
 /* An ATA channel (aka controller).
@@ -66,8 +160,18 @@ struct channel
     char name[8];               /* Name, e.g. "ide0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
+    uint16_t bm_base;           /* Bus-master I/O port, 0 if no DMA. */
+    struct prd *prdt;           /* PRD table, null if no DMA. */
 
     struct lock lock;           /* Must acquire to access the controller. */
+
+    /* Request queue, in arrival order.  Drained by the channel's
+       dispatcher thread, which alone issues read and write
+       commands. */
+    struct list queue;          /* Pending struct io_requests. */
+    struct lock queue_lock;     /* Protects QUEUE and HEAD. */
+    struct condition queue_not_empty;
+    block_sector_t head;        /* Sector just past the last command. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
@@ -85,8 +189,23 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static uint16_t find_bus_master (void);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
+static void submit_request (struct ata_disk *, block_sector_t, size_t cnt,
+                            void *buffer, bool write);
+static void queue_request (struct ata_disk *, block_sector_t, size_t cnt,
+                           uint8_t *buffer, bool write);
+static thread_func dispatcher NO_RETURN;
+static struct io_request *pick_request (struct channel *);
+static struct io_request *find_adjacent (struct channel *,
+                                         const struct io_request *);
+static void execute_command (struct io_request *[], size_t req_cnt);
+static bool dma_transfer (struct io_request *[], size_t req_cnt,
+                          size_t sec_cnt);
+static void pio_read (struct io_request *[], size_t req_cnt, size_t sec_cnt);
+static void pio_write (struct io_request *[], size_t req_cnt,
+                       size_t sec_cnt);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
@@ -101,6 +220,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = ide_dma ? find_bus_master () : 0;
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -126,6 +246,20 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      list_init (&c->queue);
+      lock_init (&c->queue_lock);
+      cond_init (&c->queue_not_empty);
+      c->head = 0;
+
+      /* Set up bus-master DMA, if available. */
+      c->bm_base = 0;
+      c->prdt = NULL;
+      if (bm_base != 0)
+        {
+          c->prdt = palloc_get_page (PAL_ZERO);
+          if (c->prdt != NULL)
+            c->bm_base = bm_base + chan_no * 8;
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +270,9 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma_bytes = d->pio_bytes = d->cmd_cnt = 0;
+          d->cmd_cycles = d->max_cmd_cycles = 0;
+          d->request_cnt = d->merge_cnt = 0;
         }
 
       /* Register interrupt handler. */
@@ -144,6 +281,10 @@ ide_init (void)
       /* Reset hardware. */
       reset_channel (c);
 
+      /* Start dispatcher, which must be running before disks are
+         registered because partition_scan() reads from them. */
+      thread_create (c->name, PRI_MAX, dispatcher, c);
+
       /* Distinguish ATA hard disks from other devices. */
       if (check_device_type (&c->devices[0]))
         check_device_type (&c->devices[1]);
@@ -337,6 +478,29 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                   void *buffer)
+{
+  submit_request (d_, sec_no, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the disk has acknowledged receiving all of the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                    const void *buffer)
+{
+  submit_request (d_, sec_no, cnt, (void *) buffer, true);
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
@@ -344,16 +508,7 @@ descramble_ata_string (char *string, int size)
 static void
 ide_read (void *d_, block_sector_t sec_no, void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  ide_read_multiple (d_, sec_no, 1, buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -363,37 +518,443 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
    per-disk locking is unneeded. */
 static void
 ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+{
+  ide_write_multiple (d_, sec_no, 1, buffer);
+}
+
+/* Prints disk D's transfer statistics. */
+static void
+ide_print_stats (void *d_)
 {
   struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+
+  printf ("%s: %llu commands, %llu bytes by DMA, %llu bytes by PIO, ",
+          d->name, d->cmd_cnt, d->dma_bytes, d->pio_bytes);
+  printf ("%llu cycles/command (max %llu)\n",
+          d->cmd_cnt > 0 ? d->cmd_cycles / d->cmd_cnt : 0,
+          d->max_cmd_cycles);
+  printf ("%s: %s scheduler, %llu requests, %llu merged\n",
+          d->name, io_sched_names[io_sched], d->request_cnt, d->merge_cnt);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple,
+    ide_print_stats
   };
-
+
+/* Request queueing and dispatch. */
+
+/* Selects the I/O scheduling policy named NAME, which must be
+   "fifo", "clook", or "deadline".  Returns true if successful,
+   false if NAME is unknown. */
+bool
+ide_set_scheduler (const char *name)
+{
+  int i;
+
+  for (i = 0; i < IOSCHED_CNT; i++)
+    if (!strcmp (name, io_sched_names[i]))
+      {
+        io_sched = i;
+        return true;
+      }
+  return false;
+}
+
+/* Queues a transfer of CNT sectors starting at SEC_NO between
+   disk D and BUFFER, writing to the disk if WRITE is true and
+   reading from it otherwise, and waits for it to complete.
+
+   The dispatcher thread runs without a user page directory, so
+   it can only touch kernel memory.  A BUFFER in user memory is
+   instead copied through a kernel page here, in the submitter's
+   context, where touching it may fault the page in. */
+static void
+submit_request (struct ata_disk *d, block_sector_t sec_no, size_t cnt,
+                void *buffer_, bool write)
+{
+  uint8_t *buffer = buffer_;
+  uint8_t *bounce;
+
+  if (is_kernel_vaddr (buffer))
+    {
+      queue_request (d, sec_no, cnt, buffer, write);
+      return;
+    }
+
+  bounce = palloc_get_page (PAL_ASSERT);
+  while (cnt > 0)
+    {
+      size_t chunk = cnt < PGSIZE / BLOCK_SECTOR_SIZE
+                     ? cnt : PGSIZE / BLOCK_SECTOR_SIZE;
+      size_t size = chunk * BLOCK_SECTOR_SIZE;
+
+      if (write)
+        memcpy (bounce, buffer, size);
+      queue_request (d, sec_no, chunk, bounce, write);
+      if (!write)
+        memcpy (buffer, bounce, size);
+
+      sec_no += chunk;
+      buffer += size;
+      cnt -= chunk;
+    }
+  palloc_free_page (bounce);
+}
+
+/* Queues a transfer of CNT sectors starting at SEC_NO between
+   disk D and kernel BUFFER, as for submit_request(), and waits
+   for it to complete. */
+static void
+queue_request (struct ata_disk *d, block_sector_t sec_no, size_t cnt,
+               uint8_t *buffer, bool write)
+{
+  struct channel *c = d->channel;
+
+  ASSERT (is_kernel_vaddr (buffer));
+
+  while (cnt > 0)
+    {
+      struct io_request r;
+
+      r.disk = d;
+      r.sec_no = sec_no;
+      r.cnt = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      r.buffer = buffer;
+      r.write = write;
+      r.deadline = timer_ticks () + (write ? WRITE_EXPIRE : READ_EXPIRE);
+      sema_init (&r.done, 0);
+
+      lock_acquire (&c->queue_lock);
+      list_push_back (&c->queue, &r.elem);
+      d->request_cnt++;
+      cond_signal (&c->queue_not_empty, &c->queue_lock);
+      lock_release (&c->queue_lock);
+      sema_down (&r.done);
+
+      sec_no += r.cnt;
+      buffer += r.cnt * BLOCK_SECTOR_SIZE;
+      cnt -= r.cnt;
+    }
+}
+
+/* Dispatcher thread for channel C_.  Repeatedly takes the
+   request chosen by the scheduling policy off the queue, along
+   with any queued requests that continue it on disk, and serves
+   them all with a single command. */
+static void
+dispatcher (void *c_)
+{
+  struct channel *c = c_;
+
+  for (;;)
+    {
+      struct io_request *batch[MAX_MERGE];
+      struct io_request *r;
+      size_t req_cnt, sec_cnt;
+      size_t i;
+
+      lock_acquire (&c->queue_lock);
+      while (list_empty (&c->queue))
+        cond_wait (&c->queue_not_empty, &c->queue_lock);
+      r = pick_request (c);
+      list_remove (&r->elem);
+      batch[0] = r;
+      req_cnt = 1;
+      sec_cnt = r->cnt;
+      while (req_cnt < MAX_MERGE
+             && (r = find_adjacent (c, r)) != NULL
+             && sec_cnt + r->cnt <= MAX_SECTORS_PER_CMD)
+        {
+          list_remove (&r->elem);
+          batch[req_cnt++] = r;
+          sec_cnt += r->cnt;
+        }
+      c->head = batch[0]->sec_no + sec_cnt;
+      lock_release (&c->queue_lock);
+
+      execute_command (batch, req_cnt);
+      for (i = 0; i < req_cnt; i++)
+        sema_up (&batch[i]->done);
+    }
+}
+
+/* Returns the queued request in C that the scheduling policy
+   says to serve next.  C's queue must not be empty. */
+static struct io_request *
+pick_request (struct channel *c)
+{
+  struct io_request *ahead = NULL, *lowest = NULL;
+  struct list_elem *e;
+
+  ASSERT (!list_empty (&c->queue));
+
+  if (io_sched == IOSCHED_FIFO)
+    return list_entry (list_front (&c->queue), struct io_request, elem);
+
+  if (io_sched == IOSCHED_DEADLINE)
+    {
+      /* Serve the oldest request whose deadline has passed. */
+      int64_t now = timer_ticks ();
+      for (e = list_begin (&c->queue); e != list_end (&c->queue);
+           e = list_next (e))
+        {
+          struct io_request *r = list_entry (e, struct io_request, elem);
+          if (r->deadline <= now)
+            return r;
+        }
+    }
+
+  /* C-LOOK: the lowest sector at or past the head, or the lowest
+     sector overall if the head has passed every request. */
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e))
+    {
+      struct io_request *r = list_entry (e, struct io_request, elem);
+      if (r->sec_no >= c->head && (ahead == NULL || r->sec_no < ahead->sec_no))
+        ahead = r;
+      if (lowest == NULL || r->sec_no < lowest->sec_no)
+        lowest = r;
+    }
+  return ahead != NULL ? ahead : lowest;
+}
+
+/* Returns a request in C's queue that accesses the same disk in
+   the same direction as PREV and starts at the sector just past
+   PREV's last one, or a null pointer if there is none. */
+static struct io_request *
+find_adjacent (struct channel *c, const struct io_request *prev)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e))
+    {
+      struct io_request *r = list_entry (e, struct io_request, elem);
+      if (r->disk == prev->disk && r->write == prev->write
+          && r->sec_no == prev->sec_no + prev->cnt)
+        return r;
+    }
+  return NULL;
+}
+
+/* Serves the REQ_CNT requests in BATCH, which access consecutive
+   sectors of the same disk in the same direction, with a single
+   command.  Uses DMA if enabled and possible for every request's
+   buffer, otherwise PIO. */
+static void
+execute_command (struct io_request *batch[], size_t req_cnt)
+{
+  struct ata_disk *d = batch[0]->disk;
+  struct channel *c = d->channel;
+  size_t sec_cnt = 0;
+  uint64_t start, cycles;
+  bool dma;
+  size_t i;
+
+  for (i = 0; i < req_cnt; i++)
+    sec_cnt += batch[i]->cnt;
+
+  lock_acquire (&c->lock);
+  start = rdtsc ();
+  dma = dma_transfer (batch, req_cnt, sec_cnt);
+  if (!dma)
+    {
+      if (batch[0]->write)
+        pio_write (batch, req_cnt, sec_cnt);
+      else
+        pio_read (batch, req_cnt, sec_cnt);
+    }
+  cycles = rdtsc () - start;
+  lock_release (&c->lock);
+
+  d->cmd_cnt++;
+  d->merge_cnt += req_cnt - 1;
+  d->cmd_cycles += cycles;
+  if (cycles > d->max_cmd_cycles)
+    d->max_cmd_cycles = cycles;
+  if (dma)
+    d->dma_bytes += sec_cnt * BLOCK_SECTOR_SIZE;
+  else
+    d->pio_bytes += sec_cnt * BLOCK_SECTOR_SIZE;
+}
+
+/* Reads the SEC_CNT sectors requested by the REQ_CNT requests in
+   BATCH in PIO mode.  The disk raises one interrupt per sector as
+   its data becomes ready.  The channel must be locked. */
+static void
+pio_read (struct io_request *batch[], size_t req_cnt, size_t sec_cnt)
+{
+  struct ata_disk *d = batch[0]->disk;
+  struct channel *c = d->channel;
+  size_t i, j;
+
+  select_sector (d, batch[0]->sec_no, sec_cnt);
+  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+  for (i = 0; i < req_cnt; i++)
+    for (j = 0; j < batch[i]->cnt; j++)
+      {
+        sema_down (&c->completion_wait);
+        if (!wait_while_busy (d))
+          PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                 d->name, batch[i]->sec_no + j);
+        input_sector (c, (uint8_t *) batch[i]->buffer
+                         + j * BLOCK_SECTOR_SIZE);
+      }
+}
+
+/* Writes the SEC_CNT sectors requested by the REQ_CNT requests
+   in BATCH in PIO mode.  The disk raises one interrupt per sector
+   once it has accepted the data.  The channel must be locked. */
+static void
+pio_write (struct io_request *batch[], size_t req_cnt, size_t sec_cnt)
+{
+  struct ata_disk *d = batch[0]->disk;
+  struct channel *c = d->channel;
+  size_t i, j;
+
+  select_sector (d, batch[0]->sec_no, sec_cnt);
+  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+  for (i = 0; i < req_cnt; i++)
+    for (j = 0; j < batch[i]->cnt; j++)
+      {
+        if (!wait_while_busy (d))
+          PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                 d->name, batch[i]->sec_no + j);
+        output_sector (c, (uint8_t *) batch[i]->buffer
+                          + j * BLOCK_SECTOR_SIZE);
+        sema_down (&c->completion_wait);
+      }
+}
+
+/* Transfers the SEC_CNT sectors requested by the REQ_CNT requests
+   in BATCH by bus-master DMA, with one PRD table entry or more
+   per request.  The caller sleeps on the channel's completion
+   semaphore while the controller moves the data.  The channel
+   must be locked.
+
+   Returns false without doing anything if DMA is unavailable or
+   some buffer is not suitable for it, in which case the caller
+   should fall back to PIO.  Only kernel virtual addresses can be
+   used, because their physical addresses are known and
+   contiguous. */
+static bool
+dma_transfer (struct io_request *batch[], size_t req_cnt, size_t sec_cnt)
+{
+  struct ata_disk *d = batch[0]->disk;
+  struct channel *c = d->channel;
+  bool write = batch[0]->write;
+  size_t prd_cnt = 0;
+  uint8_t status;
+  size_t i;
+
+  if (c->prdt == NULL)
+    return false;
+  for (i = 0; i < req_cnt; i++)
+    if (!is_kernel_vaddr (batch[i]->buffer)
+        || (uintptr_t) batch[i]->buffer % 2 != 0)
+      return false;
+
+  /* Build the PRD table, splitting at 64 kB boundaries. */
+  for (i = 0; i < req_cnt; i++)
+    {
+      uintptr_t addr = vtop (batch[i]->buffer);
+      uintptr_t end = addr + batch[i]->cnt * BLOCK_SECTOR_SIZE;
+
+      while (addr < end)
+        {
+          uintptr_t boundary = (addr | 0xffff) + 1;
+          uintptr_t region_end = end < boundary ? end : boundary;
+
+          ASSERT (prd_cnt < PGSIZE / sizeof *c->prdt);
+          c->prdt[prd_cnt].addr = addr;
+          c->prdt[prd_cnt].size = region_end - addr;  /* 64 kB wraps to 0. */
+          c->prdt[prd_cnt].flags = 0;
+          prd_cnt++;
+          addr = region_end;
+        }
+    }
+  c->prdt[prd_cnt - 1].flags = PRD_EOT;
+
+  /* Program the bus master, then the disk, then start. */
+  outb (reg_bm_command (c), write ? 0 : BM_CMD_READ);
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+  select_sector (d, batch[0]->sec_no, sec_cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+
+  /* Sleep until the disk interrupts, then stop the bus master. */
+  sema_down (&c->completion_wait);
+  outb (reg_bm_command (c), 0);
+  status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+  if ((status & BM_STA_ERR) || (inb (reg_alt_status (c)) & STA_ERR))
+    PANIC ("%s: DMA %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", batch[0]->sec_no);
+  return true;
+}
+
+/* Returns the base I/O port of the first PCI IDE controller
+   capable of bus-master DMA, or 0 if there is none.  Enables
+   bus mastering on the controller it finds. */
+static uint16_t
+find_bus_master (void)
+{
+  int dev, fn;
+
+  for (dev = 0; dev < 32; dev++)
+    for (fn = 0; fn < 8; fn++)
+      {
+        uint32_t addr = 0x80000000 | (dev << 11) | (fn << 8);
+        uint32_t id, class, bar4, command;
+
+        outl (PCI_CONFIG_ADDR, addr);
+        id = inl (PCI_CONFIG_DATA);
+        if ((id & 0xffff) == 0xffff)
+          continue;
+
+        /* Class 01h, subclass 01h is an IDE controller; bit 7 of
+           the programming interface means it can bus master. */
+        outl (PCI_CONFIG_ADDR, addr | 0x08);
+        class = inl (PCI_CONFIG_DATA);
+        if ((class >> 16) != 0x0101 || !(class & 0x8000))
+          continue;
+
+        outl (PCI_CONFIG_ADDR, addr | 0x20);
+        bar4 = inl (PCI_CONFIG_DATA);
+        if (!(bar4 & 1))
+          continue;
+
+        /* Enable I/O space and bus mastering. */
+        outl (PCI_CONFIG_ADDR, addr | 0x04);
+        command = inl (PCI_CONFIG_DATA);
+        outl (PCI_CONFIG_ADDR, addr | 0x04);
+        outl (PCI_CONFIG_DATA, (command & 0xffff) | 0x05);
+
+        printf ("ide: bus-master DMA at port %#x\n", bar4 & 0xfffc);
+        return bar4 & 0xfffc;
+      }
+  return 0;
+}
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -1,6 +1,12 @@
 #ifndef DEVICES_IDE_H
 #define DEVICES_IDE_H
 
+#include <stdbool.h>
+
+/* Use bus-master DMA when the controller supports it? */
+extern bool ide_dma;
+
 void ide_init (void);
+bool ide_set_scheduler (const char *name);
 
 #endif /* devices/ide.h */
@@ -2,15 +2,25 @@
 #include <debug.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Held by the thread taking keys out of BUFFER.  input_read()
+   removes keys with interrupts on, so it must not race another
+   reader on the buffer's tail. */
+static struct lock reader_lock;
+
+static intq_stop_func ends_read;
+
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
   intq_init (&buffer);
+  lock_init (&reader_lock);
 }
 
 /* Adds a key to the input buffer.
@@ -33,14 +43,51 @@ input_getc (void)
   enum intr_level old_level;
   uint8_t key;
 
+  lock_acquire (&reader_lock);
   old_level = intr_disable ();
   key = intq_getc (&buffer);
   serial_notify ();
   intr_set_level (old_level);
+  lock_release (&reader_lock);
   
   return key;
 }
 
+/* Reads up to N keys from the input buffer into BUF, waiting for
+   keys to be pressed as necessary, and returns the number read.
+   Stops early after a null byte or the end of a line.  Drains
+   whatever the buffer holds in one batch instead of turning
+   interrupts off for every key.  BUF must be in kernel memory,
+   because a fault on it would leave the reader lock held. */
+size_t
+input_read (uint8_t *buf, size_t n) 
+{
+  enum intr_level old_level;
+  size_t cnt = 0;
+
+  ASSERT (is_kernel_vaddr (buf));
+
+  lock_acquire (&reader_lock);
+  while (cnt < n && (cnt == 0 || !ends_read (buf[cnt - 1])))
+    {
+      size_t got = intq_getn (&buffer, buf + cnt, n - cnt, ends_read);
+      int key = -1;
+
+      /* Sleep for a key only if none were buffered. */
+      old_level = intr_disable ();
+      if (got == 0)
+        key = intq_getc (&buffer);
+      serial_notify ();
+      intr_set_level (old_level);
+
+      cnt += got;
+      if (key >= 0)
+        buf[cnt++] = key;
+    }
+  lock_release (&reader_lock);
+  return cnt;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
@@ -50,3 +97,11 @@ input_full (void)
   ASSERT (intr_get_level () == INTR_OFF);
   return intq_full (&buffer);
 }
+
+/* Returns true if KEY ends an input_read(): a null byte, or the
+   carriage return or newline that ends a line. */
+static bool
+ends_read (uint8_t key) 
+{
+  return key == '\0' || key == '\r' || key == '\n';
+}
@@ -1,5 +1,6 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
 #include "threads/thread.h"
 
 static int next (int pos);
@@ -74,6 +75,50 @@ intq_putc (struct intq *q, uint8_t byte)
   signal (q, &q->not_empty);
 }
 
+/* Removes up to N bytes from Q into BUF without sleeping and
+   returns the number removed, which is 0 if Q is empty.  If STOP
+   is nonnull, stops after the first byte for which it returns
+   true, leaving the rest in Q.
+   May be called with interrupts on, but no other thread may
+   remove bytes from Q until it returns. */
+size_t
+intq_getn (struct intq *q, uint8_t *buf, size_t n, intq_stop_func *stop) 
+{
+  int head = q->head;
+  int tail = q->tail;
+  size_t cnt, room, chunk, i;
+
+  /* Read HEAD before the bytes it publishes. */
+  barrier ();
+
+  cnt = (head - tail + INTQ_BUFSIZE) % INTQ_BUFSIZE;
+  if (cnt > n)
+    cnt = n;
+  room = INTQ_BUFSIZE - tail;
+  chunk = room < cnt ? room : cnt;
+  memcpy (buf, q->buf + tail, chunk);
+  memcpy (buf + chunk, q->buf, cnt - chunk);
+  if (stop != NULL)
+    for (i = 0; i < cnt; i++)
+      if (stop (buf[i]))
+        {
+          cnt = i + 1;
+          break;
+        }
+
+  /* Finish reading the bytes before handing their slots back. */
+  barrier ();
+  q->tail = (tail + cnt) % INTQ_BUFSIZE;
+
+  if (cnt > 0 && q->not_full != NULL) 
+    {
+      enum intr_level old_level = intr_disable ();
+      signal (q, &q->not_full);
+      intr_set_level (old_level);
+    }
+  return cnt;
+}
+
 /* Returns the position after POS within an intq. */
 static int
 next (int pos) 
@@ -8,8 +8,15 @@
    kernel threads and external interrupt handlers.
 
    Interrupt queue functions can be called from kernel threads or
-   from external interrupt handlers.  Except for intq_init(),
-   interrupts must be off in either case.
+   from external interrupt handlers.  Except for intq_init() and
+   intq_getn(), interrupts must be off in either case.
+
+   Only the producer writes HEAD and only the consumer writes
+   TAIL.  That lets intq_getn() remove a batch of bytes without
+   turning interrupts off, which it needs only to wake a thread
+   sleeping in intq_putc().  Interrupt handlers can still add
+   bytes meanwhile, but another thread must not remove any, so
+   callers with several consumer threads must serialize them.
 
    The interrupt queue has the structure of a "monitor".  Locks
    and condition variables from threads/synch.h cannot be used in
@@ -17,6 +24,10 @@
    protect kernel threads from one another, not from interrupt
    handlers. */
 
+/* Returns true if BYTE should be the last one taken by
+   intq_getn(). */
+typedef bool intq_stop_func (uint8_t byte);
+
 /* Queue buffer size, in bytes. */
 #define INTQ_BUFSIZE 64
 
@@ -30,8 +41,8 @@ struct intq
 
     /* Queue. */
     uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
-    int head;                   /* New data is written here. */
-    int tail;                   /* Old data is read here. */
+    int head;                   /* New data is written here (producer). */
+    int tail;                   /* Old data is read here (consumer). */
   };
 
 void intq_init (struct intq *);
@@ -39,5 +50,6 @@ bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
 void intq_putc (struct intq *, uint8_t);
+size_t intq_getn (struct intq *, uint8_t *, size_t, intq_stop_func *);
 
 #endif /* devices/intq.h */
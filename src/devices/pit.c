@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -51,16 +48,31 @@ pit_configure_channel (int channel, int mode, int frequency)
   ASSERT (channel == 0 || channel == 2);
   ASSERT (mode == 2 || mode == 3);
 
+  count = pit_frequency_to_count (frequency);
+
+  /* Configure the PIT mode and load its counters. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (mode << 1));
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the number of PIT cycles in each period of a channel
+   configured by pit_configure_channel() for FREQUENCY. */
+int
+pit_frequency_to_count (int frequency)
+{
   /* Convert FREQUENCY to a PIT counter value.  The PIT has a
      clock that runs at PIT_HZ cycles per second.  We must
      translate FREQUENCY into a number of these cycles. */
   if (frequency < 19)
     {
       /* Frequency is too low: the quotient would overflow the
-         16-bit counter.  Force it to 0, which the PIT treats as
-         65536, the highest possible count.  This yields a 18.2
+         16-bit counter.  Use 65536, the highest possible count,
+         which the PIT's counter holds as 0.  This yields a 18.2
          Hz timer, approximately. */
-      count = 0;
+      return 65536;
     }
   else if (frequency > PIT_HZ)
     {
@@ -69,15 +81,29 @@ pit_configure_channel (int channel, int mode, int frequency)
          is illegal in mode 2, so we force it to 2, which yields
          a 596.590 kHz timer, approximately.  (This timer rate is
          probably too fast to be useful anyhow.) */
-      count = 2;
+      return 2;
     }
   else
-    count = (PIT_HZ + frequency / 2) / frequency;
+    return (PIT_HZ + frequency / 2) / frequency;
+}
 
-  /* Configure the PIT mode and load its counters. */
+/* Returns the current value of CHANNEL's counter, which counts
+   down from the channel's period to 1 and then reloads.  A
+   value of 0 stands for 65536. */
+uint16_t
+pit_read_counter (int channel)
+{
+  uint16_t count;
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  /* Latch the counter, then read it low byte first. */
   old_level = intr_disable ();
-  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (mode << 1));
-  outb (PIT_PORT_COUNTER (channel), count);
-  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  outb (PIT_PORT_CONTROL, channel << 6);
+  count = inb (PIT_PORT_COUNTER (channel));
+  count |= inb (PIT_PORT_COUNTER (channel)) << 8;
   intr_set_level (old_level);
+
+  return count;
 }
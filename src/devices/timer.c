@@ -4,12 +4,11 @@
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
-static struct list sleeping_list;
-  
 /* See [8254] for hardware details of the 8254 timer chip. */
 
 #if TIMER_FREQ < 19
@@ -22,11 +21,38 @@ static struct list sleeping_list;
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Sleeping threads, as a min-heap ordered by wakeup tick, so
+   that a tick on which no thread is due costs one comparison
+   and waking K threads costs O(K log N). */
+static struct heap sleep_heap;
+static uint64_t sleep_seq;      /* Next sleep_seq to hand out. */
+
+/* If true, the idle thread stops the periodic tick. */
+bool timer_tickless;
+
+/* Most ticks the PIT can be programmed to span.  Its counter is
+   16 bits wide, so it cannot run slower than about 19 Hz. */
+#define MAX_IDLE_TICKS (TIMER_FREQ / 19)
+
+/* Number of ticks that the next timer interrupt stands for.
+   This is 1 except while the idle thread has slowed the PIT. */
+static int tick_period = 1;
+static int64_t skipped_ticks;   /* Ticks that never interrupted. */
+
+/* PIT cycles that went by in periods cut short by
+   set_tick_period() and have not yet added up to a tick. */
+static int pit_carry;
+
+/* Most CPU cycles spent in one call to timer_interrupt(). */
+static uint64_t max_tick_cycles;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static heap_less_func wakeup_less;
+static void set_tick_period (int);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -39,7 +65,7 @@ timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-  list_init(&sleeping_list);
+  heap_init (&sleep_heap, wakeup_less, NULL);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -92,17 +118,33 @@ timer_elapsed (int64_t then)
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
-  enum intr_level prior_level;
+  timer_sleep_until (timer_ticks () + ticks);
+}
+
+/* Sleeps until the timer tick count reaches DEADLINE, returning
+   immediately if it already has.  Interrupts must be turned on.
+
+   A thread that runs periodically should advance its deadline
+   by its period each time and call this function, rather than
+   timer_sleep(), so that the time it spends running does not
+   accumulate as drift. */
+void
+timer_sleep_until (int64_t deadline) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  prior_level = intr_disable();
-  thread_current()->wakeup_counter = start + ticks;
-  list_push_back(&sleeping_list, &thread_current()->elem);
-  thread_block();
-  intr_set_level(prior_level);
-  /*while (timer_elapsed (start) < ticks) */
-    /*thread_yield ();*/
+
+  old_level = intr_disable ();
+  if (deadline > ticks) 
+    {
+      cur->wakeup_counter = deadline;
+      cur->sleep_seq = sleep_seq++;
+      heap_insert (&sleep_heap, &cur->sleep_elem);
+      thread_block ();
+    }
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -168,36 +210,160 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, slows the PIT so that its
+   next interrupt arrives when the earliest sleeping thread is
+   due, instead of one tick from now.
+
+   The period is kept a divisor of TIMER_FREQ so that each idle
+   interrupt stands for a whole number of ticks, and is cut short
+   at the next tick on which the MLFQS or aging scheduler does
+   its periodic bookkeeping.  No time slice can expire while the
+   CPU is idle, because timer_idle_end() restores the normal rate
+   before any other thread runs. */
+void
+timer_idle_begin (void) 
+{
+  int64_t limit = MAX_IDLE_TICKS;
+  int period;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless)
+    return;
+
+  if (!heap_empty (&sleep_heap)) 
+    {
+      struct thread *t = heap_entry (heap_min (&sleep_heap),
+                                     struct thread, sleep_elem);
+      if (t->wakeup_counter - ticks < limit)
+        limit = t->wakeup_counter - ticks;
+    }
+  if (thread_prior_aging || thread_mlfqs) 
+    {
+      if (PRIORITY_RECALC_FREQ - ticks % PRIORITY_RECALC_FREQ < limit)
+        limit = PRIORITY_RECALC_FREQ - ticks % PRIORITY_RECALC_FREQ;
+      if (TIMER_FREQ - ticks % TIMER_FREQ < limit)
+        limit = TIMER_FREQ - ticks % TIMER_FREQ;
+    }
+
+  for (period = limit; period > 1; period--)
+    if (TIMER_FREQ % period == 0)
+      break;
+  if (period > 1)
+    set_tick_period (period);
+}
+
+/* Called with interrupts off when the idle thread gives up the
+   CPU.  If the CPU was woken by some interrupt other than the
+   timer, restores the normal tick rate, which credits the ticks
+   that have elapsed since timer_idle_begin(). */
+void
+timer_idle_end (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  set_tick_period (1);
+}
+
+/* Returns the number of ticks skipped by tickless idle. */
+int64_t
+timer_skipped_ticks (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t t = skipped_ticks;
+  intr_set_level (old_level);
+  return t;
+}
+
+/* Returns the most CPU cycles that one timer interrupt has
+   taken since boot. */
+uint64_t
+timer_max_tick_cycles (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint64_t cycles = max_tick_cycles;
+  intr_set_level (old_level);
+  return cycles;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRIu64" cycles in slowest tick\n",
+          timer_ticks (), timer_max_tick_cycles ());
 }
 
-/* Timer interrupt handler. */
+/* Programs the PIT to interrupt once every PERIOD ticks, unless
+   it already does.  Reprogramming restarts the PIT's count, so
+   the part of the current period that has gone by is added to
+   pit_carry first, and the whole ticks in pit_carry are credited
+   to the tick count.  The fraction of a tick left over carries
+   over to the next reprogramming instead of being lost. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED) {
-    struct thread* t;
+set_tick_period (int period) 
+{
+  int count, left, tick_count, elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (period == tick_period)
+    return;
+
+  count = pit_frequency_to_count (TIMER_FREQ / tick_period);
+  left = pit_read_counter (0);
+  if (left == 0)
+    left = 65536;
+  pit_configure_channel (0, 2, TIMER_FREQ / period);
+  tick_period = period;
+
+  tick_count = pit_frequency_to_count (TIMER_FREQ);
+  pit_carry += count - left;
+  elapsed = pit_carry / tick_count;
+  pit_carry %= tick_count;
+  ticks += elapsed;
+  skipped_ticks += elapsed;
+}
+
+/* Returns true if sleeping thread A should wake before B. */
+static bool
+wakeup_less (const struct heap_elem *a_, const struct heap_elem *b_,
+             void *aux UNUSED) 
+{
+  const struct thread *a = heap_entry (a_, struct thread, sleep_elem);
+  const struct thread *b = heap_entry (b_, struct thread, sleep_elem);
 
-    ticks++;
+  if (a->wakeup_counter != b->wakeup_counter)
+    return a->wakeup_counter < b->wakeup_counter;
+  return a->sleep_seq < b->sleep_seq;
+}
 
-    struct list_elem* e = list_begin(&sleeping_list);
+/* Timer interrupt handler. */
+static void
+timer_interrupt (struct intr_frame *args UNUSED) {
+    uint64_t start = rdtsc ();
+    uint64_t cycles;
 
-    while(e != list_end(&sleeping_list)) {
-        t = list_entry(e, struct thread, elem);
+    ticks += tick_period;
+    if (tick_period > 1) {
+        skipped_ticks += tick_period - 1;
+        set_tick_period(1);
+    }
 
-        if (ticks < t->wakeup_counter) {
-            e = list_next(e);
-        } else {
-            e = list_remove(e);
-            thread_unblock(t);
-        }
+    /* Wake up every thread that is due, earliest first. */
+    while (!heap_empty(&sleep_heap)) {
+        struct thread *t = heap_entry(heap_min(&sleep_heap),
+                                      struct thread, sleep_elem);
+        if (t->wakeup_counter > ticks)
+            break;
+        heap_pop_min(&sleep_heap);
+        thread_unblock(t);
     }
 
     //aging conditions
     if(thread_prior_aging || thread_mlfqs) {
-        thread_current()->recent_cpu = f_add_i(thread_current()->recent_cpu, 1);
+        update_recent_cpu();
 
         if(!(timer_ticks()%TIMER_FREQ))
             update_load_avg_recent_cpu();
@@ -205,6 +371,10 @@ timer_interrupt (struct intr_frame *args UNUSED) {
             update_priority();
     }
     thread_tick ();
+
+    cycles = rdtsc () - start;
+    if (cycles > max_tick_cycles)
+        max_tick_cycles = cycles;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -0,0 +1,99 @@
+/* fsbench.c
+
+   Runs several processes that each write and then read back
+   their own file, printing progress to the console as they go,
+   to check that file system throughput scales with the number
+   of independent files.  Run it with different process counts,
+   e.g.
+        pintos ... -- -q run 'fsbench 1'
+        pintos ... -- -q run 'fsbench 4'
+   and compare the "Timer:" ticks printed at shutdown. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Size of each worker's file. */
+#define FILE_SIZE (32 * 1024)
+
+/* Bytes per read or write call. */
+#define CHUNK_SIZE 512
+
+/* Times each worker writes and reads its file. */
+#define PASSES 4
+
+/* Most workers. */
+#define MAX_WORKERS 8
+
+/* Writes and reads back file NAME PASSES times.  Returns true if
+   the data read back matched. */
+static bool
+work (const char *name)
+{
+  static char buf[CHUNK_SIZE], check[CHUNK_SIZE];
+  int pass, ofs, fd;
+
+  if (!create (name, 0) || (fd = open (name)) < 0)
+    return false;
+  for (pass = 0; pass < PASSES; pass++)
+    {
+      memset (buf, 'a' + pass, sizeof buf);
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+        if (write (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+          return false;
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+        if (read (fd, check, CHUNK_SIZE) != CHUNK_SIZE
+            || memcmp (buf, check, CHUNK_SIZE))
+          return false;
+      printf ("%s: pass %d done\n", name, pass);
+    }
+  close (fd);
+  remove (name);
+  return true;
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  pid_t children[MAX_WORKERS];
+  char cmd[32];
+  int workers = 4;
+  int failed = 0;
+  int i;
+
+  /* Child: fsbench -w FILE. */
+  if (argc == 3 && !strcmp (argv[1], "-w"))
+    return work (argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  if (argc == 2)
+    workers = atoi (argv[1]);
+  if (workers < 1 || workers > MAX_WORKERS)
+    {
+      printf ("usage: fsbench [WORKERS]  (1 to %d)\n", MAX_WORKERS);
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < workers; i++)
+    {
+      snprintf (cmd, sizeof cmd, "fsbench -w fsbench%d", i);
+      children[i] = exec (cmd);
+      if (children[i] == PID_ERROR)
+        {
+          printf ("%s: exec failed\n", cmd);
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < workers; i++)
+    if (wait (children[i]) != EXIT_SUCCESS)
+      {
+        printf ("worker %d failed\n", i);
+        failed++;
+      }
+
+  printf ("fsbench: %d workers, %d bytes each, %d failed\n",
+          workers, FILE_SIZE * PASSES * 2, failed);
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
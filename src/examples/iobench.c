@@ -0,0 +1,99 @@
+/* iobench.c
+
+   Runs several processes that read separate files at the same
+   time, to compare the disk scheduling policies.  Run it once
+   per policy, e.g.
+        pintos ... -- -q -iosched=clook run 'iobench 4'
+   and divide the bytes it reports by the "Timer:" ticks and
+   compare the disk statistics printed at shutdown. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Size of each reader's file. */
+#define FILE_SIZE (128 * 1024)
+
+/* Bytes read per call. */
+#define CHUNK_SIZE 1024
+
+/* Most readers. */
+#define MAX_READERS 8
+
+/* Reads file NAME from start to end and returns the number of
+   bytes read, or -1 on error. */
+static int
+read_file (const char *name)
+{
+  static char buf[CHUNK_SIZE];
+  int fd, total = 0, n;
+
+  fd = open (name);
+  if (fd < 0)
+    return -1;
+  while ((n = read (fd, buf, sizeof buf)) > 0)
+    total += n;
+  close (fd);
+  return total;
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  pid_t children[MAX_READERS];
+  char name[20], cmd[32];
+  int readers = 4;
+  int total = 0;
+  int i;
+
+  /* Child: iobench -r FILE. */
+  if (argc == 3 && !strcmp (argv[1], "-r"))
+    return read_file (argv[2]) == FILE_SIZE ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  if (argc == 2)
+    readers = atoi (argv[1]);
+  if (readers < 1 || readers > MAX_READERS)
+    {
+      printf ("usage: iobench [READERS]  (1 to %d)\n", MAX_READERS);
+      return EXIT_FAILURE;
+    }
+
+  /* Create one file per reader. */
+  for (i = 0; i < readers; i++)
+    {
+      snprintf (name, sizeof name, "iobench%d", i);
+      remove (name);
+      if (!create (name, FILE_SIZE))
+        {
+          printf ("%s: create failed\n", name);
+          return EXIT_FAILURE;
+        }
+    }
+
+  /* Start readers, then wait for all of them. */
+  for (i = 0; i < readers; i++)
+    {
+      snprintf (cmd, sizeof cmd, "iobench -r iobench%d", i);
+      children[i] = exec (cmd);
+      if (children[i] == PID_ERROR)
+        {
+          printf ("%s: exec failed\n", cmd);
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < readers; i++)
+    if (wait (children[i]) == EXIT_SUCCESS)
+      total += FILE_SIZE;
+    else
+      printf ("reader %d failed\n", i);
+
+  printf ("iobench: %d readers read %d bytes\n", readers, total);
+
+  for (i = 0; i < readers; i++)
+    {
+      snprintf (name, sizeof name, "iobench%d", i);
+      remove (name);
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/* openbench.c
+
+   Creates N empty files and holds all of them open at once, then
+   times opening and closing a few more files, to measure open()
+   as the number of open inodes grows.  A process may hold only
+   about 120 files open, so the files are spread over a chain of
+   N / 120 processes, each exec'ing the next; give the kernel
+   enough memory for them.  Run it with several N, e.g.
+        pintos -m 64 ... -- -q run 'openbench 10'
+        pintos -m 64 ... -- -q run 'openbench 10000'
+   and compare the cycles/open figures it prints and the
+   "Inodes:" line printed at shutdown. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Files held open per process, under the kernel's per-process
+   descriptor limit. */
+#define HOLD 120
+
+/* Files opened and closed while the others are held open, and
+   passes over them. */
+#define PROBES 100
+#define ROUNDS 20
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Times opening each probe file, which is not yet open, while N
+   other files are.  Returns an exit status. */
+static int
+probe (int n)
+{
+  uint64_t cycles = 0;
+  char name[20];
+  int round, i;
+
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < PROBES; i++)
+      {
+        uint64_t start;
+        int fd;
+
+        snprintf (name, sizeof name, "op%d", i);
+        start = rdtsc ();
+        fd = open (name);
+        cycles += rdtsc () - start;
+        if (fd < 0)
+          {
+            printf ("%s: open failed\n", name);
+            return EXIT_FAILURE;
+          }
+        close (fd);
+      }
+
+  printf ("openbench: %d inodes open, %llu cycles/open\n",
+          n, cycles / (ROUNDS * PROBES));
+  return EXIT_SUCCESS;
+}
+
+/* Opens files FIRST through N - 1 and keeps them open, HOLD of
+   them in this process and the rest in a child started with
+   "openbench -h N FIRST".  The last process in the chain runs
+   probe() once all N are open.  Returns an exit status. */
+static int
+hold (int n, int first)
+{
+  int fds[HOLD];
+  int cnt = n - first < HOLD ? n - first : HOLD;
+  int status = EXIT_FAILURE;
+  char name[20], cmd[48];
+  int i, opened;
+
+  for (opened = 0; opened < cnt; opened++)
+    {
+      snprintf (name, sizeof name, "ob%d", first + opened);
+      fds[opened] = open (name);
+      if (fds[opened] < 0)
+        {
+          printf ("%s: open failed\n", name);
+          goto done;
+        }
+    }
+
+  if (first + cnt < n)
+    {
+      pid_t child;
+
+      snprintf (cmd, sizeof cmd, "openbench -h %d %d", n, first + cnt);
+      child = exec (cmd);
+      if (child == PID_ERROR)
+        printf ("%s: exec failed\n", cmd);
+      else
+        status = wait (child);
+    }
+  else
+    status = probe (n);
+
+ done:
+  for (i = 0; i < opened; i++)
+    close (fds[i]);
+  return status;
+}
+
+/* Creates or, if CREATING is false, removes files PREFIX0 through
+   PREFIX<CNT - 1>.  Returns true if successful. */
+static bool
+make_files (const char *prefix, int cnt, bool creating)
+{
+  char name[20];
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      snprintf (name, sizeof name, "%s%d", prefix, i);
+      if (!creating)
+        remove (name);
+      else if (!create (name, 0))
+        {
+          printf ("%s: create failed\n", name);
+          return false;
+        }
+    }
+  return true;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int n, status;
+
+  /* Child: openbench -h N FIRST. */
+  if (argc == 4 && !strcmp (argv[1], "-h"))
+    return hold (atoi (argv[2]), atoi (argv[3]));
+
+  if (argc != 2 || (n = atoi (argv[1])) <= 0)
+    {
+      printf ("usage: openbench N\n");
+      return EXIT_FAILURE;
+    }
+
+  status = EXIT_FAILURE;
+  if (make_files ("ob", n, true) && make_files ("op", PROBES, true))
+    status = hold (n, 0);
+  make_files ("ob", n, false);
+  make_files ("op", PROBES, false);
+  return status;
+}
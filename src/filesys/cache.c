@@ -0,0 +1,546 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* A cached copy of one sector of the file system device. */
+struct cache_entry
+  {
+    block_sector_t sector;              /* Sector held in DATA. */
+    bool valid;                         /* True if DATA holds SECTOR. */
+    bool dirty;                         /* True if DATA differs from disk. */
+    bool accessed;                      /* Reference bit for the clock. */
+    bool io_busy;                       /* True while being read in
+                                           or written back. */
+    int64_t dirty_since;                /* Tick when DIRTY became true. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+  };
+
+/* The buffer cache.
+   Sits between the file system and fs_device.  Every access to
+   the file system device goes through here, including the sectors
+   that hold on-disk inodes.  CACHE_LOCK protects the entries'
+   metadata; it is dropped while a sector is read in or written
+   back so that hits can proceed in parallel, and IO_DONE is
+   signaled once the transfer completes. */
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static struct condition io_done;
+
+/* A run of sectors that cache_write_multiple() is writing
+   straight to disk.  Until the write completes, those sectors
+   may not be cached or read. */
+struct direct_write
+  {
+    block_sector_t sector;              /* First sector. */
+    size_t cnt;                         /* Number of sectors. */
+    struct list_elem elem;              /* Element in direct_writes. */
+  };
+
+/* Direct writes in progress.  Protected by CACHE_LOCK. */
+static struct list direct_writes;
+
+/* Clock hand used to pick eviction victims. */
+static size_t clock_hand;
+
+/* Number of dirty entries. */
+static int dirty_cnt;
+
+/* Flusher tunables, settable from the kernel command line.
+   The flusher wakes every CACHE_FLUSH_INTERVAL ticks and writes
+   back sectors that have been dirty for CACHE_MAX_DIRTY_AGE
+   ticks or more.  A writer that pushes the number of dirty
+   sectors above CACHE_DIRTY_HIGH writes sectors back itself. */
+int64_t cache_flush_interval = TIMER_FREQ;
+int64_t cache_max_dirty_age = 3 * TIMER_FREQ;
+int cache_dirty_high = CACHE_SIZE * 3 / 4;
+
+/* Statistics. */
+static long long hit_cnt;               /* Lookups satisfied from cache. */
+static long long miss_cnt;              /* Lookups that went to disk. */
+static long long writeback_cnt;         /* Dirty sectors written back. */
+static long long read_ahead_cnt;        /* Sectors brought in by read-ahead. */
+
+/* Read-ahead requests.
+   A circular queue of sectors for the read-ahead daemon to bring
+   into the cache.  Requests are dropped if the queue is full. */
+#define RA_QUEUE_SIZE 64
+static block_sector_t ra_queue[RA_QUEUE_SIZE];
+static size_t ra_head, ra_tail;         /* Next to pop, next free slot. */
+static struct lock ra_lock;
+static struct condition ra_not_empty;
+
+static thread_func read_ahead_daemon NO_RETURN;
+static thread_func flush_daemon NO_RETURN;
+
+static struct cache_entry *lookup (block_sector_t);
+static bool writing_directly (block_sector_t);
+static struct cache_entry *wait_idle (block_sector_t);
+static struct cache_entry *evict (void);
+static struct cache_entry *load_entry (block_sector_t, bool need_read);
+static struct cache_entry *get_entry (block_sector_t, bool need_read);
+static void write_back (struct cache_entry *);
+static void flush_dirty (int64_t min_age, int target_cnt);
+
+/* Initializes the buffer cache. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  cond_init (&io_done);
+  list_init (&direct_writes);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].valid = false;
+      cache[i].dirty = false;
+      cache[i].accessed = false;
+      cache[i].io_busy = false;
+    }
+  clock_hand = 0;
+  dirty_cnt = 0;
+
+  lock_init (&ra_lock);
+  cond_init (&ra_not_empty);
+  ra_head = ra_tail = 0;
+  thread_create ("read-ahead", PRI_DEFAULT, read_ahead_daemon, NULL);
+  thread_create ("flusher", PRI_DEFAULT, flush_daemon, NULL);
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Reads SIZE bytes starting at byte offset OFS within sector
+   SECTOR into BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = get_entry (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  lock_release (&cache_lock);
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER into sector
+   SECTOR.  The data reaches the disk when the sector is evicted
+   or flushed. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER into sector SECTOR, starting at
+   byte offset OFS within the sector.  A partial write reads the
+   rest of the sector from disk first if it is not cached.
+   If too many sectors are dirty, writes half of them back before
+   returning. */
+void
+cache_write_at (block_sector_t sector, const void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = get_entry (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  if (!e->dirty)
+    {
+      e->dirty = true;
+      e->dirty_since = timer_ticks ();
+      dirty_cnt++;
+    }
+  if (dirty_cnt > cache_dirty_high)
+    flush_dirty (0, cache_dirty_high / 2);
+  lock_release (&cache_lock);
+}
+
+/* Reads CNT consecutive sectors starting at SECTOR into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.
+   Sectors already cached are copied from the cache; each run of
+   uncached sectors is read straight into BUFFER with a single
+   device request, without displacing anything from the cache. */
+void
+cache_read_multiple (block_sector_t sector, size_t cnt, void *buffer_)
+{
+  uint8_t *buffer = buffer_;
+  size_t i = 0;
+
+  lock_acquire (&cache_lock);
+  while (i < cnt)
+    {
+      struct cache_entry *e;
+      size_t run;
+
+      e = wait_idle (sector + i);
+      if (e != NULL)
+        {
+          hit_cnt++;
+          e->accessed = true;
+          memcpy (buffer + i * BLOCK_SECTOR_SIZE, e->data, BLOCK_SECTOR_SIZE);
+          i++;
+          continue;
+        }
+
+      /* A sector absent from the cache is current on disk, so the
+         lock need not be held while reading it. */
+      for (run = 1; i + run < cnt; run++)
+        if (lookup (sector + i + run) != NULL
+            || writing_directly (sector + i + run))
+          break;
+      miss_cnt += run;
+      lock_release (&cache_lock);
+      block_read_multiple (fs_device, sector + i, run,
+                           buffer + i * BLOCK_SECTOR_SIZE);
+      lock_acquire (&cache_lock);
+      i += run;
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes, straight to
+   disk with as few device requests as possible.  Cached copies
+   of those sectors are discarded, so this suits large writes of
+   data that is not expected to be read back soon. */
+void
+cache_write_multiple (block_sector_t sector, size_t cnt, const void *buffer)
+{
+  struct direct_write w;
+  bool waited;
+  size_t i;
+
+  lock_acquire (&cache_lock);
+
+  /* Wait until no sector in the range is being read in, written
+     back, or written directly.  Waiting drops the lock, letting
+     sectors already checked become busy again, so check the whole
+     range over after every wait. */
+  do
+    {
+      waited = false;
+      for (i = 0; i < cnt; i++)
+        {
+          struct cache_entry *e = lookup (sector + i);
+          if ((e != NULL && e->io_busy) || writing_directly (sector + i))
+            {
+              cond_wait (&io_done, &cache_lock);
+              waited = true;
+              break;
+            }
+        }
+    }
+  while (waited);
+
+  /* Discard cached copies. */
+  for (i = 0; i < cnt; i++)
+    {
+      struct cache_entry *e = lookup (sector + i);
+      if (e == NULL)
+        continue;
+      if (e->dirty)
+        dirty_cnt--;
+      e->dirty = false;
+      e->valid = false;
+    }
+
+  /* Write without the lock.  Publishing the range keeps anyone
+     from caching or reading the old contents meanwhile. */
+  w.sector = sector;
+  w.cnt = cnt;
+  list_push_back (&direct_writes, &w.elem);
+  lock_release (&cache_lock);
+  block_write_multiple (fs_device, sector, cnt, buffer);
+  lock_acquire (&cache_lock);
+  list_remove (&w.elem);
+  cond_broadcast (&io_done, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Asks the read-ahead daemon to bring SECTOR into the cache in
+   the background.  Never blocks on disk I/O. */
+void
+cache_read_ahead (block_sector_t sector)
+{
+  lock_acquire (&ra_lock);
+  if ((ra_tail + 1) % RA_QUEUE_SIZE != ra_head)
+    {
+      ra_queue[ra_tail] = sector;
+      ra_tail = (ra_tail + 1) % RA_QUEUE_SIZE;
+      cond_signal (&ra_not_empty, &ra_lock);
+    }
+  lock_release (&ra_lock);
+}
+
+/* Writes every dirty sector back to disk. */
+void
+cache_flush (void)
+{
+  lock_acquire (&cache_lock);
+  flush_dirty (0, 0);
+  lock_release (&cache_lock);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %lld hits, %lld misses, %lld writebacks, "
+          "%lld read-ahead\n",
+          hit_cnt, miss_cnt, writeback_cnt, read_ahead_cnt);
+}
+
+/* Returns the cache entry holding SECTOR, or a null pointer if
+   SECTOR is not cached. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Returns true if cache_write_multiple() is writing SECTOR
+   straight to disk. */
+static bool
+writing_directly (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&direct_writes); e != list_end (&direct_writes);
+       e = list_next (e))
+    {
+      struct direct_write *w = list_entry (e, struct direct_write, elem);
+      if (sector >= w->sector && sector - w->sector < w->cnt)
+        return true;
+    }
+  return false;
+}
+
+/* Waits until SECTOR is neither being read in, written back, nor
+   written directly, and returns its cache entry, or a null
+   pointer if it is not cached.  The cache lock must be held; it
+   is released and reacquired while waiting. */
+static struct cache_entry *
+wait_idle (block_sector_t sector)
+{
+  for (;;)
+    {
+      struct cache_entry *e = lookup (sector);
+      if (e != NULL ? !e->io_busy : !writing_directly (sector))
+        return e;
+      cond_wait (&io_done, &cache_lock);
+    }
+}
+
+/* Chooses a cache entry to reuse with the clock algorithm and
+   returns it.  A dirty entry is written back before reuse; the
+   cache lock is released and reacquired meanwhile, and the clock
+   moves on and comes back to the entry later.  If a full sweep
+   finds every entry busy, waits for some I/O to finish. */
+static struct cache_entry *
+evict (void)
+{
+  size_t busy_cnt = 0;          /* Busy entries seen in a row. */
+
+  for (;;)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (!e->valid)
+        return e;
+      if (e->io_busy)
+        {
+          if (++busy_cnt >= CACHE_SIZE)
+            {
+              cond_wait (&io_done, &cache_lock);
+              busy_cnt = 0;
+            }
+          continue;
+        }
+      busy_cnt = 0;
+      if (e->accessed)
+        e->accessed = false;
+      else if (e->dirty)
+        write_back (e);
+      else
+        {
+          e->valid = false;
+          return e;
+        }
+    }
+}
+
+/* Brings SECTOR into a newly evicted cache entry and returns it.
+   If NEED_READ is false, the caller is about to overwrite the
+   whole sector, so it is not read from disk.  The cache lock
+   must be held; it is released and reacquired while the sector
+   is read in, and possibly while a victim is found.  Returns a
+   null pointer if another thread cached SECTOR meanwhile. */
+static struct cache_entry *
+load_entry (block_sector_t sector, bool need_read)
+{
+  struct cache_entry *e = evict ();
+
+  if (lookup (sector) != NULL || writing_directly (sector))
+    return NULL;
+
+  e->sector = sector;
+  e->valid = true;
+  e->dirty = false;
+  e->accessed = true;
+  if (need_read)
+    {
+      e->io_busy = true;
+      lock_release (&cache_lock);
+      block_read (fs_device, sector, e->data);
+      lock_acquire (&cache_lock);
+      e->io_busy = false;
+      cond_broadcast (&io_done, &cache_lock);
+    }
+  else
+    memset (e->data, 0, BLOCK_SECTOR_SIZE);
+  return e;
+}
+
+/* Returns the cache entry for SECTOR, bringing it into the cache
+   if necessary.  NEED_READ is as for load_entry().  The cache
+   lock must be held. */
+static struct cache_entry *
+get_entry (block_sector_t sector, bool need_read)
+{
+  struct cache_entry *e;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  do
+    {
+      e = wait_idle (sector);
+      if (e != NULL)
+        {
+          hit_cnt++;
+          e->accessed = true;
+          return e;
+        }
+      e = load_entry (sector, need_read);
+    }
+  while (e == NULL);
+  miss_cnt++;
+  return e;
+}
+
+/* Writes dirty entry E back to disk.  The cache lock must be
+   held; it is released and reacquired during the write.  E
+   cannot be modified or evicted meanwhile because it is busy. */
+static void
+write_back (struct cache_entry *e)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+  ASSERT (e->dirty && !e->io_busy);
+
+  e->dirty = false;
+  dirty_cnt--;
+  writeback_cnt++;
+  e->io_busy = true;
+  lock_release (&cache_lock);
+  block_write (fs_device, e->sector, e->data);
+  lock_acquire (&cache_lock);
+  e->io_busy = false;
+  cond_broadcast (&io_done, &cache_lock);
+}
+
+/* Writes back, in ascending sector order to keep head movement
+   down, the sectors that have been dirty for at least MIN_AGE
+   ticks.  Stops early once no more than TARGET_CNT sectors are
+   dirty.  The cache lock must be held. */
+static void
+flush_dirty (int64_t min_age, int target_cnt)
+{
+  struct cache_entry *victims[CACHE_SIZE];
+  int64_t now = timer_ticks ();
+  size_t cnt = 0;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Gather old enough dirty entries, insertion-sorted by sector. */
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      size_t j;
+
+      if (!e->valid || !e->dirty || e->io_busy
+          || now - e->dirty_since < min_age)
+        continue;
+      for (j = cnt; j > 0 && victims[j - 1]->sector > e->sector; j--)
+        victims[j] = victims[j - 1];
+      victims[j] = e;
+      cnt++;
+    }
+
+  /* Entries may change while the lock is dropped in write_back(),
+     so recheck each one before writing it. */
+  for (i = 0; i < cnt && dirty_cnt > target_cnt; i++)
+    if (victims[i]->valid && victims[i]->dirty && !victims[i]->io_busy)
+      write_back (victims[i]);
+}
+
+/* Flusher daemon.  Periodically writes back sectors that have
+   been dirty for too long, bounding how much data a crash can
+   lose. */
+static void
+flush_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (cache_flush_interval > 0 ? cache_flush_interval : 1);
+
+      lock_acquire (&cache_lock);
+      flush_dirty (cache_max_dirty_age, 0);
+      lock_release (&cache_lock);
+    }
+}
+
+/* Read-ahead daemon.  Pops sectors queued by cache_read_ahead()
+   and reads each one into the cache unless it is already there. */
+static void
+read_ahead_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      lock_acquire (&ra_lock);
+      while (ra_head == ra_tail)
+        cond_wait (&ra_not_empty, &ra_lock);
+      sector = ra_queue[ra_head];
+      ra_head = (ra_head + 1) % RA_QUEUE_SIZE;
+      lock_release (&ra_lock);
+
+      lock_acquire (&cache_lock);
+      if (lookup (sector) == NULL && !writing_directly (sector)
+          && load_entry (sector, true) != NULL)
+        read_ahead_cnt++;
+      lock_release (&cache_lock);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+
+/* Number of sectors held by the buffer cache. */
+#define CACHE_SIZE 64
+
+/* Flusher tunables.  See cache.c for details. */
+extern int64_t cache_flush_interval;
+extern int64_t cache_max_dirty_age;
+extern int cache_dirty_high;
+
+void cache_init (void);
+void cache_read (block_sector_t, void *);
+void cache_read_at (block_sector_t, void *, int ofs, int size);
+void cache_write (block_sector_t, const void *);
+void cache_write_at (block_sector_t, const void *, int ofs, int size);
+void cache_read_multiple (block_sector_t, size_t cnt, void *);
+void cache_write_multiple (block_sector_t, size_t cnt, const void *);
+void cache_read_ahead (block_sector_t);
+void cache_flush (void);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
@@ -1,10 +1,13 @@
 #include "filesys/directory.h"
+#include <hash.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,12 +24,176 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
-/* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+/* Directory formats.
+
+   A linear directory, the original format, is an array of
+   struct dir_entry that is searched from start to end.
+
+   A hashed directory, marked by INODE_HASHED_DIR in its inode,
+   is laid out in one-sector slots.  Slot 0 holds a struct
+   dir_header and every other slot a struct dir_bucket.  Names
+   are placed with linear hashing: the directory starts with
+   BASE_CNT home buckets, and each time the entries outgrow them
+   one more home bucket is added by splitting the bucket at SPLIT,
+   so growth costs a bounded amount of work per insertion.  Home
+   bucket I always lives in slot I + 1.  A full bucket is chained
+   to overflow buckets, taken from a free list of emptied buckets
+   or else appended at the end of the directory; an overflow
+   bucket in the way of a new home bucket is moved elsewhere
+   first.  Free buckets are linked through the same NEXT and PREV
+   fields as chains, with PREV 0 only at the head. */
+
+/* Identifies a hashed directory header. */
+#define DIR_MAGIC 0x44495248
+
+/* Header of a hashed directory, in slot 0. */
+struct dir_header
+  {
+    unsigned magic;                     /* DIR_MAGIC. */
+    uint32_t base_cnt;                  /* Home buckets at level 0. */
+    uint32_t level;                     /* Number of doublings done. */
+    uint32_t split;                     /* Next home bucket to split. */
+    uint32_t entry_cnt;                 /* Entries in use. */
+    uint32_t free_list;                 /* First free bucket, or 0. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 6 * sizeof (uint32_t)];
+  };
+
+/* Entries per bucket. */
+#define BUCKET_ENTRIES \
+  ((BLOCK_SECTOR_SIZE - 2 * sizeof (uint32_t)) / sizeof (struct dir_entry))
+
+/* A bucket of a hashed directory. */
+struct dir_bucket
+  {
+    uint32_t next;                      /* Next slot in chain, or 0. */
+    uint32_t prev;                      /* Previous slot in chain, or 0. */
+    struct dir_entry entries[BUCKET_ENTRIES];
+    uint8_t unused[BLOCK_SECTOR_SIZE - 2 * sizeof (uint32_t)
+                   - BUCKET_ENTRIES * sizeof (struct dir_entry)];
+  };
+
+/* A hashed directory gains a home bucket whenever its entries
+   would fill more than LOAD_NUM / LOAD_DEN of them. */
+#define LOAD_NUM 3
+#define LOAD_DEN 4
+
+/* Name lookup cache.
+   A direct-mapped cache from (directory, name) to the sector of
+   the named file's inode, shared by all directories of either
+   format.  Entries are dropped when the name is removed. */
+#define NAME_CACHE_SIZE 64
+
+struct name_cache_entry
+  {
+    bool valid;                         /* In use? */
+    block_sector_t dir_sector;          /* Directory's inode sector. */
+    block_sector_t inode_sector;        /* File's inode sector. */
+    char name[NAME_MAX + 1];            /* File name. */
+  };
+
+static struct name_cache_entry name_cache[NAME_CACHE_SIZE];
+static struct adaptive_lock name_cache_lock;
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  adaptive_lock_init (&name_cache_lock);
+  lock_stats_register (&name_cache_lock.stats, "name cache");
+}
+
+/* Returns the name cache slot for NAME in DIR. */
+static struct name_cache_entry *
+name_cache_slot (const struct dir *dir, const char *name)
+{
+  unsigned h = hash_string (name) ^ hash_int (inode_get_inumber (dir->inode));
+  return &name_cache[h % NAME_CACHE_SIZE];
+}
+
+/* Looks up NAME in DIR in the name cache.  Returns true and
+   stores the inode sector in *SECTOR if found. */
+static bool
+name_cache_get (const struct dir *dir, const char *name,
+                block_sector_t *sector)
+{
+  struct name_cache_entry *nc = name_cache_slot (dir, name);
+  bool found;
+
+  adaptive_lock_acquire (&name_cache_lock);
+  found = (nc->valid
+           && nc->dir_sector == inode_get_inumber (dir->inode)
+           && !strcmp (nc->name, name));
+  if (found)
+    *sector = nc->inode_sector;
+  adaptive_lock_release (&name_cache_lock);
+  return found;
+}
+
+/* Records in the name cache that NAME in DIR has its inode in
+   SECTOR. */
+static void
+name_cache_put (const struct dir *dir, const char *name,
+                block_sector_t sector)
+{
+  struct name_cache_entry *nc = name_cache_slot (dir, name);
+
+  adaptive_lock_acquire (&name_cache_lock);
+  nc->valid = true;
+  nc->dir_sector = inode_get_inumber (dir->inode);
+  nc->inode_sector = sector;
+  strlcpy (nc->name, name, sizeof nc->name);
+  adaptive_lock_release (&name_cache_lock);
+}
+
+/* Drops NAME in DIR from the name cache. */
+static void
+name_cache_drop (const struct dir *dir, const char *name)
+{
+  struct name_cache_entry *nc = name_cache_slot (dir, name);
+
+  adaptive_lock_acquire (&name_cache_lock);
+  if (nc->valid && nc->dir_sector == inode_get_inumber (dir->inode)
+      && !strcmp (nc->name, name))
+    nc->valid = false;
+  adaptive_lock_release (&name_cache_lock);
+}
+
+/* Creates a hashed directory with space for ENTRY_CNT entries in
+   the given SECTOR.  Returns true if successful, false on
+   failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_header *h;
+  struct inode *inode;
+  size_t base_cnt;
+  bool success = false;
+
+  ASSERT (sizeof (struct dir_header) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct dir_bucket) == BLOCK_SECTOR_SIZE);
+
+  base_cnt = DIV_ROUND_UP (entry_cnt * LOAD_DEN, BUCKET_ENTRIES * LOAD_NUM);
+  if (base_cnt == 0)
+    base_cnt = 1;
+
+  /* New sectors read as zeros, which makes every bucket empty. */
+  if (!inode_create (sector, (base_cnt + 1) * BLOCK_SECTOR_SIZE))
+    return false;
+  inode = inode_open (sector);
+  h = calloc (1, sizeof *h);
+  if (inode != NULL && h != NULL)
+    {
+      h->magic = DIR_MAGIC;
+      h->base_cnt = base_cnt;
+      if (inode_write_at (inode, h, sizeof *h, 0) == sizeof *h)
+        {
+          inode_set_flags (inode, inode_get_flags (inode) | INODE_HASHED_DIR);
+          success = true;
+        }
+    }
+  free (h);
+  inode_close (inode);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -83,14 +250,23 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
-/* Searches DIR for a file with the given NAME.
+/* Returns true if DIR is in the hashed format. */
+static bool
+is_hashed (const struct dir *dir)
+{
+  return (inode_get_flags (dir->inode) & INODE_HASHED_DIR) != 0;
+}
+
+/* Linear directories. */
+
+/* Searches linear DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
    otherwise, returns false and ignores EP and OFSP. */
 static bool
-lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+linear_lookup (const struct dir *dir, const char *name,
+               struct dir_entry *ep, off_t *ofsp) 
 {
   struct dir_entry e;
   size_t ofs;
@@ -111,6 +287,439 @@ lookup (const struct dir *dir, const char *name,
   return false;
 }
 
+/* Adds E to linear DIR.  Returns true if successful, false on
+   failure. */
+static bool
+linear_add (struct dir *dir, const struct dir_entry *e)
+{
+  struct dir_entry slot;
+  off_t ofs;
+
+  /* Set OFS to offset of free slot.
+     If there are no free slots, then it will be set to the
+     current end-of-file.
+     
+     inode_read_at() will only return a short read at end of file.
+     Otherwise, we'd need to verify that we didn't get a short
+     read due to something intermittent such as low memory. */
+  for (ofs = 0;
+       inode_read_at (dir->inode, &slot, sizeof slot, ofs) == sizeof slot;
+       ofs += sizeof slot) 
+    if (!slot.in_use)
+      break;
+
+  /* Write slot. */
+  return inode_write_at (dir->inode, e, sizeof *e, ofs) == sizeof *e;
+}
+
+/* Hashed directories. */
+
+/* Reads slot SLOT of hashed DIR into BUF, which must have room
+   for BLOCK_SECTOR_SIZE bytes.  Returns true if successful. */
+static bool
+read_slot (const struct dir *dir, uint32_t slot, void *buf)
+{
+  return (inode_read_at (dir->inode, buf, BLOCK_SECTOR_SIZE,
+                         (off_t) slot * BLOCK_SECTOR_SIZE)
+          == BLOCK_SECTOR_SIZE);
+}
+
+/* Writes BUF to slot SLOT of hashed DIR, growing DIR if SLOT is
+   just past its end.  Returns true if successful. */
+static bool
+write_slot (struct dir *dir, uint32_t slot, const void *buf)
+{
+  return (inode_write_at (dir->inode, buf, BLOCK_SECTOR_SIZE,
+                          (off_t) slot * BLOCK_SECTOR_SIZE)
+          == BLOCK_SECTOR_SIZE);
+}
+
+/* Returns the number of slots in hashed DIR. */
+static uint32_t
+slot_cnt (const struct dir *dir)
+{
+  return inode_length (dir->inode) / BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the slot of the home bucket for a name with hash value
+   HASH in a hashed directory with header H. */
+static uint32_t
+home_slot (const struct dir_header *h, unsigned hash)
+{
+  uint32_t cnt = h->base_cnt << h->level;
+  uint32_t bucket = hash % cnt;
+
+  /* Buckets before the split point have already been split. */
+  if (bucket < h->split)
+    bucket = hash % (cnt * 2);
+  return bucket + 1;
+}
+
+/* Searches hashed DIR, whose header is H, for a file with the
+   given NAME.  If successful, returns true, leaves the bucket
+   holding it in *B, and sets *SLOTP and *IDXP to the bucket's
+   slot and the entry's index within it.  Otherwise, returns
+   false. */
+static bool
+hashed_lookup (const struct dir *dir, const struct dir_header *h,
+               const char *name, struct dir_bucket *b,
+               uint32_t *slotp, size_t *idxp)
+{
+  uint32_t slot;
+
+  for (slot = home_slot (h, hash_string (name)); slot != 0; slot = b->next)
+    {
+      size_t i;
+
+      if (!read_slot (dir, slot, b))
+        return false;
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        if (b->entries[i].in_use && !strcmp (name, b->entries[i].name))
+          {
+            *slotp = slot;
+            *idxp = i;
+            return true;
+          }
+    }
+  return false;
+}
+
+/* Returns true if bucket B has no entries in use. */
+static bool
+bucket_empty (const struct dir_bucket *b)
+{
+  size_t i;
+
+  for (i = 0; i < BUCKET_ENTRIES; i++)
+    if (b->entries[i].in_use)
+      return false;
+  return true;
+}
+
+/* Unlinks a bucket whose links are PREV and NEXT from its
+   overflow chain or, if PREV is 0, from the head of the free list
+   of hashed DIR, whose header is H.  Home buckets must not be
+   unlinked.  B is scratch space.  Returns true if successful. */
+static bool
+unlink_bucket (struct dir *dir, struct dir_header *h,
+               uint32_t prev, uint32_t next, struct dir_bucket *b)
+{
+  if (prev == 0)
+    h->free_list = next;
+  else
+    {
+      if (!read_slot (dir, prev, b))
+        return false;
+      b->next = next;
+      if (!write_slot (dir, prev, b))
+        return false;
+    }
+  if (next != 0)
+    {
+      if (!read_slot (dir, next, b))
+        return false;
+      b->prev = prev;
+      if (!write_slot (dir, next, b))
+        return false;
+    }
+  return true;
+}
+
+/* Empties SLOT of hashed DIR, whose header is H, and puts it at
+   the head of H's free list.  SLOT must be unlinked already, or
+   just past the end of DIR, which grows DIR.  B is scratch space.
+   Returns true if successful. */
+static bool
+free_bucket (struct dir *dir, struct dir_header *h, uint32_t slot,
+             struct dir_bucket *b)
+{
+  uint32_t next = h->free_list;
+
+  memset (b, 0, sizeof *b);
+  b->next = next;
+  if (!write_slot (dir, slot, b))
+    return false;
+  if (next != 0)
+    {
+      if (!read_slot (dir, next, b))
+        return false;
+      b->prev = slot;
+      if (!write_slot (dir, next, b))
+        return false;
+    }
+  h->free_list = slot;
+  return true;
+}
+
+/* Returns the slot of a bucket for hashed DIR, whose header is
+   H, to put to use: the head of H's free list, which is
+   unlinked, or if there is none the slot just past the end of
+   DIR, which grows DIR when the caller writes it.  B is scratch
+   space.  Returns 0 on failure. */
+static uint32_t
+alloc_bucket (struct dir *dir, struct dir_header *h, struct dir_bucket *b)
+{
+  uint32_t slot = h->free_list;
+
+  if (slot == 0)
+    return slot_cnt (dir);
+  if (!read_slot (dir, slot, b) || !unlink_bucket (dir, h, 0, b->next, b))
+    return 0;
+  return slot;
+}
+
+/* Grows hashed DIR, whose header is H, until H's free list holds
+   at least CNT buckets.  B is scratch space.  Returns true if
+   successful.  On failure, the buckets added so far stay free. */
+static bool
+reserve_buckets (struct dir *dir, struct dir_header *h, uint32_t cnt,
+                 struct dir_bucket *b)
+{
+  uint32_t slot;
+
+  for (slot = h->free_list; slot != 0 && cnt > 0; slot = b->next, cnt--)
+    if (!read_slot (dir, slot, b))
+      return false;
+  for (; cnt > 0; cnt--)
+    if (!free_bucket (dir, h, slot_cnt (dir), b))
+      return false;
+  return true;
+}
+
+/* Returns true if SLOT is on the free list of hashed DIR, whose
+   header is H.  B is scratch space. */
+static bool
+on_free_list (const struct dir *dir, const struct dir_header *h,
+              uint32_t slot, struct dir_bucket *b)
+{
+  uint32_t free_slot;
+
+  for (free_slot = h->free_list; free_slot != 0; free_slot = b->next)
+    if (free_slot == slot)
+      return true;
+    else if (!read_slot (dir, free_slot, b))
+      return false;
+  return false;
+}
+
+/* Stores E in the first free entry of the chain starting at
+   SLOT in hashed DIR, whose header is H, adding an overflow
+   bucket if the chain is full.  B is scratch space.  Returns
+   true if successful, false on failure. */
+static bool
+chain_add (struct dir *dir, struct dir_header *h, uint32_t slot,
+           const struct dir_entry *e, struct dir_bucket *b)
+{
+  uint32_t new_slot;
+
+  for (;;)
+    {
+      size_t i;
+
+      if (!read_slot (dir, slot, b))
+        return false;
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        if (!b->entries[i].in_use)
+          {
+            b->entries[i] = *e;
+            return write_slot (dir, slot, b);
+          }
+      if (b->next == 0)
+        break;
+      slot = b->next;
+    }
+
+  /* Chain is full: link a new overflow bucket after SLOT.  Write
+     the new bucket first, so that if DIR cannot grow the chain
+     is left as it was. */
+  new_slot = alloc_bucket (dir, h, b);
+  if (new_slot == 0)
+    return false;
+  memset (b, 0, sizeof *b);
+  b->prev = slot;
+  b->entries[0] = *e;
+  if (!write_slot (dir, new_slot, b) || !read_slot (dir, slot, b))
+    return false;
+  b->next = new_slot;
+  return write_slot (dir, slot, b);
+}
+
+/* Moves the overflow bucket in SLOT of hashed DIR, whose header
+   is H, to a bucket from alloc_bucket(), relinking its
+   neighbors.  The caller must overwrite SLOT.  B is scratch
+   space.  Returns true if successful. */
+static bool
+move_overflow (struct dir *dir, struct dir_header *h, uint32_t slot,
+               struct dir_bucket *b)
+{
+  uint32_t new_slot, prev, next;
+
+  new_slot = alloc_bucket (dir, h, b);
+  if (new_slot == 0 || !read_slot (dir, slot, b)
+      || !write_slot (dir, new_slot, b))
+    return false;
+  prev = b->prev;
+  next = b->next;
+  ASSERT (prev != 0);
+
+  if (!read_slot (dir, prev, b))
+    return false;
+  b->next = new_slot;
+  if (!write_slot (dir, prev, b))
+    return false;
+  if (next != 0)
+    {
+      if (!read_slot (dir, next, b))
+        return false;
+      b->prev = new_slot;
+      if (!write_slot (dir, next, b))
+        return false;
+    }
+  return true;
+}
+
+/* Splits the home bucket at H->SPLIT in hashed DIR, moving the
+   entries that now hash to a new home bucket there, and advances
+   H's split point.  Overflow buckets the split empties go on H's
+   free list.  The caller must write H back.  Returns true if
+   successful, false on failure.
+
+   Growing DIR is the only step that fails in practice, when the
+   disk is full, so every bucket the split needs is put on the
+   free list before anything moves.  A split that fails there
+   leaves DIR as it was, apart from any free buckets added. */
+static bool
+split_bucket (struct dir *dir, struct dir_header *h)
+{
+  uint32_t cnt = h->base_cnt << h->level;
+  uint32_t new_slot = cnt + h->split + 1;
+  struct dir_bucket *b, *scratch;
+  uint32_t slot, next, move_cnt = 0;
+  bool success = false;
+
+  b = malloc (sizeof *b);
+  scratch = malloc (sizeof *scratch);
+  if (b == NULL || scratch == NULL)
+    goto done;
+
+  /* Count the entries that hash past the old bucket count. */
+  for (slot = h->split + 1; slot != 0; slot = b->next)
+    {
+      size_t i;
+
+      if (!read_slot (dir, slot, b))
+        goto done;
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        if (b->entries[i].in_use
+            && hash_string (b->entries[i].name) % (cnt * 2) != h->split)
+          move_cnt++;
+    }
+
+  /* Reserve the new home bucket, or a bucket to move the overflow
+     bucket in its way to, and overflow buckets for the rest. */
+  if (new_slot == slot_cnt (dir) && !free_bucket (dir, h, new_slot, b))
+    goto done;
+  if (!reserve_buckets (dir, h, move_cnt > BUCKET_ENTRIES
+                                ? DIV_ROUND_UP (move_cnt, BUCKET_ENTRIES)
+                                : 1, b))
+    goto done;
+
+  /* Make room for the new home bucket. */
+  if (on_free_list (dir, h, new_slot, b))
+    {
+      if (!read_slot (dir, new_slot, b)
+          || !unlink_bucket (dir, h, b->prev, b->next, b))
+        goto done;
+    }
+  else if (!move_overflow (dir, h, new_slot, b))
+    goto done;
+  memset (b, 0, sizeof *b);
+  if (!write_slot (dir, new_slot, b))
+    goto done;
+
+  /* Move the entries. */
+  for (slot = h->split + 1; slot != 0; slot = next)
+    {
+      bool changed = false;
+      size_t i;
+
+      if (!read_slot (dir, slot, b))
+        goto done;
+      next = b->next;
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        {
+          struct dir_entry *e = &b->entries[i];
+          if (e->in_use && hash_string (e->name) % (cnt * 2) != h->split)
+            {
+              if (!chain_add (dir, h, new_slot, e, scratch))
+                goto done;
+              e->in_use = false;
+              changed = true;
+            }
+        }
+      if (!changed)
+        continue;
+      if (b->prev != 0 && bucket_empty (b))
+        {
+          if (!unlink_bucket (dir, h, b->prev, next, b)
+              || !free_bucket (dir, h, slot, b))
+            goto done;
+        }
+      else if (!write_slot (dir, slot, b))
+        goto done;
+    }
+
+  if (++h->split == cnt)
+    {
+      h->split = 0;
+      h->level++;
+    }
+  success = true;
+
+ done:
+  free (scratch);
+  free (b);
+  return success;
+}
+
+/* Adds E to hashed DIR, whose header is H, splitting a bucket if
+   DIR has grown too full, and writes H back.  Returns true if
+   successful, false on failure. */
+static bool
+hashed_add (struct dir *dir, struct dir_header *h, const struct dir_entry *e)
+{
+  struct dir_bucket *b = malloc (sizeof *b);
+  uint32_t home_cnt;
+  bool success;
+
+  if (b == NULL)
+    return false;
+  success = chain_add (dir, h, home_slot (h, hash_string (e->name)), e, b);
+  free (b);
+
+  if (success)
+    {
+      h->entry_cnt++;
+      home_cnt = (h->base_cnt << h->level) + h->split;
+
+      /* E is in place whether or not the split succeeds.  One
+         that fails leaves the buckets as they were, so the
+         directory is just fuller than planned until the next
+         insertion tries again. */
+      if (h->entry_cnt * LOAD_DEN > home_cnt * BUCKET_ENTRIES * LOAD_NUM)
+        split_bucket (dir, h);
+    }
+  return write_slot (dir, 0, h) && success;
+}
+
+/* Public interface.
+
+   Each operation holds the directory inode's lock, so that, for
+   example, checking that a name is unused and adding it happen
+   atomically. */
+
+static bool readdir (struct dir *, char name[NAME_MAX + 1]);
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
@@ -119,15 +728,49 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
-  struct dir_entry e;
+  block_sector_t sector;
+  bool found = false;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  inode_lock (dir->inode);
+  if (name_cache_get (dir, name, &sector))
+    found = true;
+  else if (is_hashed (dir))
+    {
+      struct dir_header *h = malloc (sizeof *h);
+      struct dir_bucket *b = malloc (sizeof *b);
+      uint32_t slot;
+      size_t idx;
+
+      if (h != NULL && b != NULL && read_slot (dir, 0, h)
+          && hashed_lookup (dir, h, name, b, &slot, &idx))
+        {
+          sector = b->entries[idx].inode_sector;
+          found = true;
+        }
+      free (b);
+      free (h);
+    }
+  else
+    {
+      struct dir_entry e;
+      if (linear_lookup (dir, name, &e, NULL))
+        {
+          sector = e.inode_sector;
+          found = true;
+        }
+    }
+
+  if (found)
+    {
+      name_cache_put (dir, name, sector);
+      *inode = inode_open (sector);
+    }
   else
     *inode = NULL;
+  inode_unlock (dir->inode);
 
   return *inode != NULL;
 }
@@ -142,7 +785,6 @@ bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
   struct dir_entry e;
-  off_t ofs;
   bool success = false;
 
   ASSERT (dir != NULL);
@@ -152,29 +794,31 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
-    goto done;
-
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
-
-  /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
- done:
+  inode_lock (dir->inode);
+  if (is_hashed (dir))
+    {
+      struct dir_header *h = malloc (sizeof *h);
+      struct dir_bucket *b = malloc (sizeof *b);
+      uint32_t slot;
+      size_t idx;
+
+      /* Check that NAME is not in use, then add it. */
+      if (h != NULL && b != NULL && read_slot (dir, 0, h)
+          && !hashed_lookup (dir, h, name, b, &slot, &idx))
+        success = hashed_add (dir, h, &e);
+      free (b);
+      free (h);
+    }
+  else if (!linear_lookup (dir, name, NULL, NULL))
+    success = linear_add (dir, &e);
+
+  if (success)
+    name_cache_put (dir, name, inode_sector);
+  inode_unlock (dir->inode);
   return success;
 }
 
@@ -184,16 +828,32 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_header *h = NULL;
+  struct dir_bucket *b = NULL;
   struct dir_entry e;
   struct inode *inode = NULL;
   bool success = false;
+  uint32_t slot;
+  size_t idx;
   off_t ofs;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_lock (dir->inode);
+  name_cache_drop (dir, name);
+
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (is_hashed (dir))
+    {
+      h = malloc (sizeof *h);
+      b = malloc (sizeof *b);
+      if (h == NULL || b == NULL || !read_slot (dir, 0, h)
+          || !hashed_lookup (dir, h, name, b, &slot, &idx))
+        goto done;
+      e = b->entries[idx];
+    }
+  else if (!linear_lookup (dir, name, &e, &ofs))
     goto done;
 
   /* Open inode. */
@@ -202,16 +862,39 @@ dir_remove (struct dir *dir, const char *name)
     goto done;
 
   /* Erase directory entry. */
-  e.in_use = false;
-  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
-    goto done;
+  if (h != NULL)
+    {
+      b->entries[idx].in_use = false;
+      h->entry_cnt--;
+
+      /* An overflow bucket left empty goes on the free list. */
+      if (b->prev != 0 && bucket_empty (b))
+        {
+          if (!unlink_bucket (dir, h, b->prev, b->next, b)
+              || !free_bucket (dir, h, slot, b))
+            goto done;
+        }
+      else if (!write_slot (dir, slot, b))
+        goto done;
+      if (!write_slot (dir, 0, h))
+        goto done;
+    }
+  else
+    {
+      e.in_use = false;
+      if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
+        goto done;
+    }
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  inode_unlock (dir->inode);
   inode_close (inode);
+  free (b);
+  free (h);
   return success;
 }
 
@@ -220,9 +903,47 @@ dir_remove (struct dir *dir, const char *name)
    contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+{
+  bool success;
+
+  inode_lock (dir->inode);
+  success = readdir (dir, name);
+  inode_unlock (dir->inode);
+  return success;
+}
+
+/* Does the work of dir_readdir() with DIR's lock held. */
+static bool
+readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
 
+  if (is_hashed (dir))
+    {
+      /* DIR->POS counts entries across buckets, starting with
+         slot 1's. */
+      struct dir_bucket *b = malloc (sizeof *b);
+      bool found = false;
+
+      if (b == NULL)
+        return false;
+      if (dir->pos < (off_t) BUCKET_ENTRIES)
+        dir->pos = BUCKET_ENTRIES;
+      while (!found && read_slot (dir, dir->pos / BUCKET_ENTRIES, b))
+        do
+          {
+            struct dir_entry *be = &b->entries[dir->pos++ % BUCKET_ENTRIES];
+            if (be->in_use)
+              {
+                strlcpy (name, be->name, NAME_MAX + 1);
+                found = true;
+              }
+          }
+        while (!found && dir->pos % BUCKET_ENTRIES != 0);
+      free (b);
+      return found;
+    }
+
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
@@ -1,16 +1,27 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Read-ahead window bounds, in sectors.  The window doubles on
+   each sequential read and halves on each seek. */
+#define RA_WINDOW_MIN 2
+#define RA_WINDOW_MAX 32
+
 /* An open file. */
 struct file 
   {
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    off_t ra_next;              /* Position of a sequential next read. */
+    off_t ra_end;               /* End of data already queued for read-ahead. */
+    int ra_window;              /* Read-ahead window in sectors. */
   };
 
+static void read_ahead (struct file *, off_t old_pos);
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
@@ -23,6 +34,9 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
@@ -68,11 +82,47 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
+  off_t old_pos = file->pos;
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
+  read_ahead (file, old_pos);
   return bytes_read;
 }
 
+/* Adapts FILE's read-ahead window after a read that started at
+   OLD_POS and queues the sectors that follow the new position.
+   A read that starts where the previous one ended grows the
+   window; any other read shrinks it. */
+static void
+read_ahead (struct file *file, off_t old_pos)
+{
+  off_t start, end;
+
+  if (old_pos == file->ra_next)
+    {
+      file->ra_window *= 2;
+      if (file->ra_window < RA_WINDOW_MIN)
+        file->ra_window = RA_WINDOW_MIN;
+      if (file->ra_window > RA_WINDOW_MAX)
+        file->ra_window = RA_WINDOW_MAX;
+    }
+  else
+    {
+      file->ra_window /= 2;
+      file->ra_end = 0;
+    }
+  file->ra_next = file->pos;
+
+  /* Queue only the part of the window not already queued. */
+  start = file->pos > file->ra_end ? file->pos : file->ra_end;
+  end = file->pos + file->ra_window * BLOCK_SECTOR_SIZE;
+  if (start < end)
+    {
+      inode_read_ahead (file->inode, start, end - start);
+      file->ra_end = end;
+    }
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually read,
@@ -86,11 +136,10 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
+   Writing past end of file grows the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
-   Advances FILE's position by the number of bytes read. */
+   which may be less than SIZE if the disk fills up.
+   Advances FILE's position by the number of bytes written. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
@@ -101,10 +150,9 @@ file_write (struct file *file, const void *buffer, off_t size)
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
+   Writing past end of file grows the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -4,9 +4,11 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct adaptive_lock free_map_lock; /* Protects FREE_MAP. */
 
 /* Initializes the free map. */
 void
@@ -17,6 +19,8 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  adaptive_lock_init (&free_map_lock);
+  lock_stats_register (&free_map_lock.stats, "free map");
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,7 +31,10 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  block_sector_t sector;
+
+  adaptive_lock_acquire (&free_map_lock);
+  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
       && !bitmap_write (free_map, free_map_file))
@@ -35,18 +42,47 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
       bitmap_set_multiple (free_map, sector, cnt, false); 
       sector = BITMAP_ERROR;
     }
+  adaptive_lock_release (&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates up to CNT consecutive sectors starting exactly at
+   SECTOR, stopping at the first sector already in use.
+   Returns the number of sectors allocated, which is 0 if SECTOR
+   itself is in use or the free_map file could not be written. */
+size_t
+free_map_allocate_at (block_sector_t sector, size_t cnt)
+{
+  size_t n = 0;
+
+  adaptive_lock_acquire (&free_map_lock);
+  while (n < cnt && sector + n < bitmap_size (free_map)
+         && !bitmap_test (free_map, sector + n))
+    n++;
+  if (n > 0)
+    {
+      bitmap_set_multiple (free_map, sector, n, true);
+      if (free_map_file != NULL && !bitmap_write (free_map, free_map_file))
+        {
+          bitmap_set_multiple (free_map, sector, n, false);
+          n = 0;
+        }
+    }
+  adaptive_lock_release (&free_map_lock);
+  return n;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  adaptive_lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
   bitmap_write (free_map, free_map_file);
+  adaptive_lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
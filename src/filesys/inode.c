@@ -1,23 +1,57 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/cpu.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A run of LENGTH consecutive data sectors starting at START. */
+struct extent
+  {
+    block_sector_t start;               /* First sector of the run. */
+    uint32_t length;                    /* Number of sectors. */
+  };
+
+/* Number of extents stored in the inode itself, in an indirect
+   block, and number of indirect blocks named by the doubly
+   indirect block. */
+#define DIRECT_CNT 60
+#define INDIRECT_CNT (BLOCK_SECTOR_SIZE / sizeof (struct extent))
+#define DOUBLY_CNT (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Maximum number of extents in a single inode. */
+#define MAX_EXTENTS (DIRECT_CNT + INDIRECT_CNT + DOUBLY_CNT * INDIRECT_CNT)
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   File data is described by a list of extents.  The first
+   DIRECT_CNT are stored here, the next INDIRECT_CNT in the
+   INDIRECT sector, and the rest in the indirect sectors listed
+   in the DOUBLY_INDIRECT sector.  Extents are only ever
+   appended, and the last one grows in place when the sectors
+   after it are free, so a file written sequentially tends to
+   stay in a few long runs. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t sector_cnt;                /* Number of data sectors allocated. */
+    uint32_t extent_cnt;                /* Number of extents in use. */
+    block_sector_t indirect;            /* Indirect extent block, or 0. */
+    block_sector_t doubly_indirect;     /* Doubly indirect block, or 0. */
+    struct extent direct[DIRECT_CNT];   /* Direct extents. */
+    uint32_t flags;                     /* INODE_* flags. */
+    uint32_t unused;                    /* Not used. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -31,37 +65,210 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rwlock rw;                   /* Held for reading to access data,
+                                           for writing to grow the file. */
+    struct lock lock;                   /* See inode_lock(). */
+    bool loaded;                        /* DATA read in yet? */
     struct inode_disk data;             /* Inode content. */
   };
 
+static bool extend (struct inode_disk *, off_t length);
+static void release_sectors (struct inode_disk *);
+
+/* Reads extent number IDX of DISK_INODE into *E. */
+static void
+get_extent (const struct inode_disk *disk_inode, size_t idx,
+            struct extent *e)
+{
+  block_sector_t indirect;
+
+  ASSERT (idx < disk_inode->extent_cnt);
+
+  if (idx < DIRECT_CNT)
+    {
+      *e = disk_inode->direct[idx];
+      return;
+    }
+  idx -= DIRECT_CNT;
+
+  if (idx < INDIRECT_CNT)
+    indirect = disk_inode->indirect;
+  else
+    {
+      idx -= INDIRECT_CNT;
+      cache_read_at (disk_inode->doubly_indirect, &indirect,
+                     idx / INDIRECT_CNT * sizeof indirect, sizeof indirect);
+      idx %= INDIRECT_CNT;
+    }
+  cache_read_at (indirect, e, idx * sizeof *e, sizeof *e);
+}
+
+/* Allocates a zeroed index sector and stores it in *SECTORP.
+   Returns true if successful, false if the disk is full. */
+static bool
+alloc_index_sector (block_sector_t *sectorp)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (!free_map_allocate (1, sectorp))
+    return false;
+  cache_write (*sectorp, zeros);
+  return true;
+}
+
+/* Stores E as extent number IDX of DISK_INODE, which must be
+   either an existing extent or the next one to be appended.
+   Allocates indirect blocks as needed.  Returns true if
+   successful, false if an indirect block could not be
+   allocated. */
+static bool
+set_extent (struct inode_disk *disk_inode, size_t idx,
+            const struct extent *e)
+{
+  block_sector_t indirect;
+
+  ASSERT (idx <= disk_inode->extent_cnt && idx < MAX_EXTENTS);
+
+  if (idx < DIRECT_CNT)
+    {
+      disk_inode->direct[idx] = *e;
+      return true;
+    }
+  idx -= DIRECT_CNT;
+
+  if (idx < INDIRECT_CNT)
+    {
+      if (disk_inode->indirect == 0
+          && !alloc_index_sector (&disk_inode->indirect))
+        return false;
+      indirect = disk_inode->indirect;
+    }
+  else
+    {
+      off_t ofs;
+
+      idx -= INDIRECT_CNT;
+      ofs = idx / INDIRECT_CNT * sizeof indirect;
+      idx %= INDIRECT_CNT;
+      if (disk_inode->doubly_indirect == 0
+          && !alloc_index_sector (&disk_inode->doubly_indirect))
+        return false;
+      cache_read_at (disk_inode->doubly_indirect, &indirect, ofs,
+                     sizeof indirect);
+      if (indirect == 0)
+        {
+          if (!alloc_index_sector (&indirect))
+            return false;
+          cache_write_at (disk_inode->doubly_indirect, &indirect, ofs,
+                          sizeof indirect);
+        }
+    }
+  cache_write_at (indirect, e, idx * sizeof *e, sizeof *e);
+  return true;
+}
+
+/* Position within an inode's extent list, used to make a series
+   of ascending byte_to_sector() lookups cheap. */
+struct extent_cursor
+  {
+    size_t idx;                         /* Extent index. */
+    size_t ofs;                         /* First file sector in extent. */
+    size_t len;                         /* Sectors in extent. */
+  };
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   POS.
+   The search starts from *CURSOR, which must be zeroed before
+   the first lookup, and is left at the extent found, so
+   sequential lookups need not rescan the extent list. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (const struct inode *inode, off_t pos,
+                struct extent_cursor *cursor) 
 {
+  size_t target = pos / BLOCK_SECTOR_SIZE;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
+  if (pos >= inode->data.length)
     return -1;
+
+  if (target < cursor->ofs)
+    cursor->idx = cursor->ofs = 0;
+  for (; cursor->idx < inode->data.extent_cnt; cursor->idx++)
+    {
+      struct extent e;
+
+      get_extent (&inode->data, cursor->idx, &e);
+      cursor->len = e.length;
+      if (target < cursor->ofs + e.length)
+        return e.start + (target - cursor->ofs);
+      cursor->ofs += e.length;
+    }
+  NOT_REACHED ();
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Table of open inodes, keyed by sector, so that opening a
+   single inode twice returns the same `struct inode'.
+   OPEN_INODES_LOCK protects the table and every inode's
+   open_cnt and loaded. */
+static struct hash open_inodes;
+static struct adaptive_lock open_inodes_lock;
+
+/* Statistics. */
+static long long open_call_cnt;         /* Calls to inode_open(). */
+static long long open_cycles;           /* Cycles spent in inode_open(). */
+static size_t peak_open_cnt;            /* Most inodes open at once. */
+
+/* Contention on inode rwlocks, summed over every inode as it is
+   closed for the last time.  Protected by OPEN_INODES_LOCK. */
+static struct lock_stats inode_rw_stats;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("could not allocate open inode table");
+  adaptive_lock_init (&open_inodes_lock);
+  lock_stats_register (&open_inodes_lock.stats, "open inodes");
+  lock_stats_init (&inode_rw_stats);
+  lock_stats_register (&inode_rw_stats, "inode rwlocks");
+}
+
+/* Prints open inode table statistics. */
+void
+inode_print_stats (void)
+{
+  printf ("Inodes: %lld opens, %lld cycles/open, %zu peak open\n",
+          open_call_cnt, open_call_cnt > 0 ? open_cycles / open_call_cnt : 0,
+          peak_open_cnt);
+}
+
+/* Returns a hash value for the inode containing hash element E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->sector);
+}
+
+/* Returns true if the inode containing A precedes the one
+   containing B, by sector. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -84,60 +291,188 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      if (extend (disk_inode, length)) 
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          cache_write (sector, disk_inode);
           success = true; 
         } 
+      else
+        release_sectors (disk_inode);
       free (disk_inode);
     }
   return success;
 }
 
+/* Number of sectors zeroed per device request by extend(). */
+#define ZERO_SECTORS 16
+
+/* Grows DISK_INODE to LENGTH bytes, allocating and zeroing data
+   sectors as needed.  Sectors are taken from just past the last
+   extent when they are free, otherwise from the longest free run
+   found by halving the request until it fits.
+   Returns true if successful, false if the disk is full, in
+   which case DISK_INODE keeps its old length but may own some of
+   the new sectors. */
+static bool
+extend (struct inode_disk *disk_inode, off_t length)
+{
+  static char zeros[ZERO_SECTORS * BLOCK_SECTOR_SIZE];
+  size_t want = bytes_to_sectors (length);
+
+  while (disk_inode->sector_cnt < want)
+    {
+      size_t need = want - disk_inode->sector_cnt;
+      struct extent e;
+      block_sector_t first;
+      size_t cnt, i;
+      bool append = true;
+
+      /* Try to grow the last extent in place. */
+      cnt = 0;
+      if (disk_inode->extent_cnt > 0)
+        {
+          get_extent (disk_inode, disk_inode->extent_cnt - 1, &e);
+          first = e.start + e.length;
+          cnt = free_map_allocate_at (first, need);
+          if (cnt > 0)
+            {
+              e.length += cnt;
+              append = false;
+            }
+        }
+
+      /* Otherwise start a new extent. */
+      if (append)
+        {
+          if (disk_inode->extent_cnt >= MAX_EXTENTS)
+            return false;
+          for (cnt = need; cnt > 0; cnt /= 2)
+            if (free_map_allocate (cnt, &first))
+              break;
+          if (cnt == 0)
+            return false;
+          e.start = first;
+          e.length = cnt;
+        }
+
+      for (i = 0; i < cnt; i += ZERO_SECTORS)
+        cache_write_multiple (first + i, cnt - i < ZERO_SECTORS
+                                         ? cnt - i : ZERO_SECTORS, zeros);
+      if (!set_extent (disk_inode, disk_inode->extent_cnt - !append, &e))
+        {
+          free_map_release (first, cnt);
+          return false;
+        }
+      if (append)
+        disk_inode->extent_cnt++;
+      disk_inode->sector_cnt += cnt;
+    }
+
+  if (length > disk_inode->length)
+    disk_inode->length = length;
+  return true;
+}
+
+/* Releases all of DISK_INODE's data and index sectors. */
+static void
+release_sectors (struct inode_disk *disk_inode)
+{
+  size_t idx;
+
+  for (idx = 0; idx < disk_inode->extent_cnt; idx++)
+    {
+      struct extent e;
+
+      get_extent (disk_inode, idx, &e);
+      free_map_release (e.start, e.length);
+    }
+
+  if (disk_inode->doubly_indirect != 0)
+    {
+      block_sector_t indirect[DOUBLY_CNT];
+
+      cache_read (disk_inode->doubly_indirect, indirect);
+      for (idx = 0; idx < DOUBLY_CNT; idx++)
+        if (indirect[idx] != 0)
+          free_map_release (indirect[idx], 1);
+      free_map_release (disk_inode->doubly_indirect, 1);
+    }
+  if (disk_inode->indirect != 0)
+    free_map_release (disk_inode->indirect, 1);
+}
+
 /* Reads an inode from SECTOR
    and returns a `struct inode' that contains it.
    Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
+  uint64_t start = rdtsc ();
+
+  adaptive_lock_acquire (&open_inodes_lock);
+  open_call_cnt++;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      if (inode->loaded)
         {
-          inode_reopen (inode);
-          return inode; 
+          open_cycles += rdtsc () - start;
+          adaptive_lock_release (&open_inodes_lock);
+          return inode;
         }
+      adaptive_lock_release (&open_inodes_lock);
+
+      /* Another opener is still reading it in, holding its lock
+         until done. */
+      lock_acquire (&inode->lock);
+      lock_release (&inode->lock);
+      adaptive_lock_acquire (&open_inodes_lock);
+      open_cycles += rdtsc () - start;
+      adaptive_lock_release (&open_inodes_lock);
+      return inode;
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      adaptive_lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  The inode goes into the table before it is read,
+     so that concurrent openers share it, but the disk read happens
+     without the table lock.  Until it is done, the inode's lock is
+     held and LOADED is false. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->loaded = false;
+  rwlock_init (&inode->rw);
+  lock_init (&inode->lock);
+  lock_acquire (&inode->lock);
+  hash_insert (&open_inodes, &inode->elem);
+  if (hash_size (&open_inodes) > peak_open_cnt)
+    peak_open_cnt = hash_size (&open_inodes);
+  adaptive_lock_release (&open_inodes_lock);
+
+  cache_read (inode->sector, &inode->data);
+
+  adaptive_lock_acquire (&open_inodes_lock);
+  inode->loaded = true;
+  open_cycles += rdtsc () - start;
+  adaptive_lock_release (&open_inodes_lock);
+  lock_release (&inode->lock);
   return inode;
 }
 
@@ -146,7 +481,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      adaptive_lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      adaptive_lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -157,6 +496,38 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns INODE's INODE_* flags. */
+uint32_t
+inode_get_flags (const struct inode *inode)
+{
+  return inode->data.flags;
+}
+
+/* Sets INODE's INODE_* flags to FLAGS and writes them to disk. */
+void
+inode_set_flags (struct inode *inode, uint32_t flags)
+{
+  inode->data.flags = flags;
+  cache_write (inode->sector, &inode->data);
+}
+
+/* Acquires INODE's general-purpose lock, which directories use
+   to make each operation on their entries atomic.  It is
+   independent of the locking done by inode_read_at() and
+   inode_write_at(). */
+void
+inode_lock (struct inode *inode)
+{
+  lock_acquire (&inode->lock);
+}
+
+/* Releases INODE's general-purpose lock. */
+void
+inode_unlock (struct inode *inode)
+{
+  lock_release (&inode->lock);
+}
+
 /* Closes INODE and writes it to disk.
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
@@ -167,22 +538,25 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Nothing more to do unless this was the last opener. */
+  adaptive_lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt > 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
-      if (inode->removed) 
-        {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
-        }
+      adaptive_lock_release (&open_inodes_lock);
+      return;
+    }
+  hash_delete (&open_inodes, &inode->elem);
+  lock_stats_add (&inode_rw_stats, &inode->rw.stats);
+  adaptive_lock_release (&open_inodes_lock);
 
-      free (inode); 
+  /* Deallocate blocks if removed. */
+  if (inode->removed) 
+    {
+      free_map_release (inode->sector, 1);
+      release_sectors (&inode->data);
     }
+
+  free (inode); 
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -202,12 +576,13 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  struct extent_cursor cursor = {0, 0, 0};
 
+  rwlock_acquire_read (&inode->rw);
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = byte_to_sector (inode, offset, &cursor);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -217,26 +592,35 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
       /* Number of bytes to actually copy out of this sector. */
       int chunk_size = size < min_left ? size : min_left;
+
+      /* Number of whole sectors from here that are contiguous on
+         disk and wanted by the caller. */
+      size_t run = 0;
+
       if (chunk_size <= 0)
         break;
 
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          off_t left = size < inode_left ? size : inode_left;
+          size_t extent_left = cursor.ofs + cursor.len
+                               - offset / BLOCK_SECTOR_SIZE;
+          run = left / BLOCK_SECTOR_SIZE;
+          if (run > extent_left)
+            run = extent_left;
         }
-      else 
+
+      if (run > 1)
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          /* Read the whole run with a single request. */
+          chunk_size = run * BLOCK_SECTOR_SIZE;
+          cache_read_multiple (sector_idx, run, buffer + bytes_read);
+        }
+      else
+        {
+          /* Copy the chunk out of the buffer cache. */
+          cache_read_at (sector_idx, buffer + bytes_read, sector_ofs,
+                         chunk_size);
         }
       
       /* Advance. */
@@ -244,31 +628,73 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
+  rwlock_release_read (&inode->rw);
   return bytes_read;
 }
 
+/* Queues the sectors of INODE holding bytes OFFSET through
+   OFFSET + SIZE - 1 for background read-ahead.  Sectors past the
+   end of INODE are ignored. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, off_t size)
+{
+  struct extent_cursor cursor = {0, 0, 0};
+  off_t end = offset + size;
+
+  rwlock_acquire_read (&inode->rw);
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (offset = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE); offset < end;
+       offset += BLOCK_SECTOR_SIZE)
+    cache_read_ahead (byte_to_sector (inode, offset, &cursor));
+  rwlock_release_read (&inode->rw);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Writing past end of file extends INODE, zero-filling any gap.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  struct extent_cursor cursor = {0, 0, 0};
+  bool grow;
 
   if (inode->deny_write_cnt)
     return 0;
 
+  /* Writes within the file share the inode with readers and
+     other writers; growing it requires exclusive access. */
+  grow = offset + size > inode_length (inode);
+  if (grow)
+    {
+      rwlock_acquire_write (&inode->rw);
+      if (offset + size > inode->data.length)
+        {
+          /* If the disk fills up, write as far as the sectors
+             that could be allocated reach, but grow the file only
+             by bytes that are actually written. */
+          if (!extend (&inode->data, offset + size))
+            {
+              off_t avail = (off_t) inode->data.sector_cnt * BLOCK_SECTOR_SIZE;
+              off_t end = offset + size < avail ? offset + size : avail;
+              if (offset < avail && end > inode->data.length)
+                inode->data.length = end;
+            }
+          cache_write (inode->sector, &inode->data);
+        }
+    }
+  else
+    rwlock_acquire_read (&inode->rw);
+
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = byte_to_sector (inode, offset, &cursor);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -281,39 +707,21 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      /* Copy the chunk into the buffer cache, which takes care
+         of reading in the rest of a partially written sector. */
+      cache_write_at (sector_idx, buffer + bytes_written, sector_ofs,
+                      chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
+  if (grow)
+    rwlock_release_write (&inode->rw);
+  else
+    rwlock_release_read (&inode->rw);
   return bytes_written;
 }
 
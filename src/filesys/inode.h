@@ -2,19 +2,29 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
 
+/* Inode flags. */
+#define INODE_HASHED_DIR 0x1    /* Directory in hashed format. */
+
 void inode_init (void);
+void inode_print_stats (void);
 bool inode_create (block_sector_t, off_t);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
+uint32_t inode_get_flags (const struct inode *);
+void inode_set_flags (struct inode *, uint32_t);
+void inode_lock (struct inode *);
+void inode_unlock (struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+void inode_read_ahead (struct inode *, off_t offset, off_t size);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
@@ -0,0 +1,166 @@
+/* Priority queue.
+
+   See heap.h for basic information.  The pairing heap is
+   described in M. L. Fredman et al., "The Pairing Heap: A New
+   Form of Self-Adjusting Heap", Algorithmica 1 (1986). */
+
+#include "heap.h"
+#include "../debug.h"
+
+static struct heap_elem *link (struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes heap H as an empty heap that orders its elements
+   using LESS, given auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux) 
+{
+  h->root = NULL;
+  h->elem_cnt = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into heap H. */
+void
+heap_insert (struct heap *h, struct heap_elem *e) 
+{
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  h->root = h->root != NULL ? link (h, h->root, e) : e;
+  h->elem_cnt++;
+}
+
+/* Returns the minimum element in heap H, or a null pointer if H
+   is empty. */
+struct heap_elem *
+heap_min (const struct heap *h) 
+{
+  return h->root;
+}
+
+/* Removes and returns the minimum element in heap H, which must
+   not be empty. */
+struct heap_elem *
+heap_pop_min (struct heap *h) 
+{
+  struct heap_elem *min = h->root;
+
+  ASSERT (min != NULL);
+
+  h->root = merge_pairs (h, min->child);
+  h->elem_cnt--;
+  min->child = NULL;
+  return min;
+}
+
+/* Removes element E, which must be in heap H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e) 
+{
+  struct heap_elem *sub;
+
+  if (e == h->root) 
+    {
+      heap_pop_min (h);
+      return;
+    }
+
+  /* Detach E, along with its children, from the tree. */
+  ASSERT (e->prev != NULL);
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  e->next = e->prev = NULL;
+
+  /* Meld E's children back in. */
+  sub = merge_pairs (h, e->child);
+  e->child = NULL;
+  if (sub != NULL)
+    h->root = link (h, h->root, sub);
+  h->elem_cnt--;
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (const struct heap *h) 
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+heap_empty (const struct heap *h) 
+{
+  return h->root == NULL;
+}
+
+/* Links the trees rooted at A and B, neither of which has
+   siblings, by making the greater of the two the leftmost child
+   of the other.  Returns the new root.  On a tie, A stays the
+   root, so that equal elements leave the heap in insertion
+   order when H's comparison function breaks ties that way. */
+static struct heap_elem *
+link (struct heap *h, struct heap_elem *a, struct heap_elem *b) 
+{
+  if (h->less (b, a, h->aux)) 
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  b->prev = a;
+  a->child = b;
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Combines the sibling list starting at FIRST into a single tree
+   and returns its root, or a null pointer if FIRST is null.
+   Siblings are linked in pairs from left to right, then the
+   pairs are linked from right to left. */
+static struct heap_elem *
+merge_pairs (struct heap *h, struct heap_elem *first) 
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* First pass: link adjacent pairs, pushing each result onto a
+     stack threaded through the `next' members. */
+  while (first != NULL) 
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      if (b != NULL) 
+        {
+          first = b->next;
+          a = link (h, a, b);
+        }
+      else
+        first = NULL;
+      a->next = pairs;
+      pairs = a;
+    }
+
+  /* Second pass: pop the stack, which visits the pairs from right
+     to left, accumulating them into one tree. */
+  while (pairs != NULL) 
+    {
+      struct heap_elem *a = pairs;
+
+      pairs = a->next;
+      a->next = a->prev = NULL;
+      root = root != NULL ? link (h, root, a) : a;
+    }
+  return root;
+}
@@ -0,0 +1,29 @@
+#ifndef __LIB_SCHEDSTAT_H
+#define __LIB_SCHEDSTAT_H
+
+/* Scheduler statistics, as returned by the schedstat system
+   call. */
+
+#include <stdint.h>
+
+/* Number of buckets in the scheduling latency histogram.
+   Bucket I counts wakeups after which the thread waited between
+   2**I and 2**(I+1) - 1 CPU cycles to run; bucket 0 also counts
+   waits of 0 cycles, and the last bucket also counts longer
+   waits. */
+#define SCHEDSTAT_BUCKETS 48
+
+/* CPU accounting for one thread. */
+struct thread_stat
+  {
+    int tid;                    /* Thread identifier. */
+    char name[16];              /* Thread name. */
+    int status;                 /* THREAD_RUNNING, THREAD_READY, etc. */
+    int priority;               /* Current priority. */
+    int64_t run_ticks;          /* Timer ticks spent running. */
+    unsigned voluntary_cnt;     /* Times it blocked. */
+    unsigned involuntary_cnt;   /* Times it yielded while runnable. */
+    uint64_t ready_cycles;      /* CPU cycles spent ready to run. */
+  };
+
+#endif /* lib/schedstat.h */
@@ -22,6 +22,7 @@ enum
     /* Additional system calls */
     SYS_FIBONACCI,
     SYS_MAX_OF_FOUR,
+    SYS_SCHEDSTAT,              /* Read scheduler statistics. */
 
     /* Project 3 and optionally project 4. */
     SYS_MMAP,                   /* Map a file into memory. */
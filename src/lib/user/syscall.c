@@ -211,3 +211,7 @@ int fibonacci(int num) {
 int max_of_four_int(int a, int b, int c, int d) {
     return syscall4(SYS_MAX_OF_FOUR, a, b, c, d);
 }
+
+int schedstat(struct thread_stat *stats, int max, uint64_t *hist) {
+    return syscall3(SYS_SCHEDSTAT, stats, max, hist);
+}
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <schedstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -37,6 +38,7 @@ void close (int fd);
 // Additional system calls
 int max_of_four_int(int a, int b, int c, int d);
 int fibonacci(int num);
+int schedstat(struct thread_stat *stats, int max, uint64_t *hist);
 
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
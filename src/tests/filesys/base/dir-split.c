@@ -0,0 +1,88 @@
+/* Creates enough files in the root directory to make it split
+   its hash buckets several times, then checks that every name
+   can still be found, removes half of them, and checks that
+   exactly the removed names are gone. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of files.  The root directory starts with a single
+   bucket of 25 entries and gains one each time it passes 3/4
+   full, so this makes it split about ten times. */
+#define FILE_CNT 200
+
+/* Size of a buffer for a file name. */
+#define NAME_SIZE 32
+
+/* Stores the name of file I into NAME. */
+static void
+file_name (char name[NAME_SIZE], int i)
+{
+  snprintf (name, NAME_SIZE, "split%d", i);
+}
+
+/* Checks that each file from FIRST up to FILE_CNT, stepping by
+   STEP, can be opened if EXISTS is true or cannot if it is
+   false. */
+static void
+check_files (int first, int step, bool exists)
+{
+  char name[NAME_SIZE];
+  int i;
+
+  for (i = first; i < FILE_CNT; i += step)
+    {
+      int fd;
+
+      file_name (name, i);
+      fd = open (name);
+      if (exists && fd < 2)
+        fail ("open \"%s\" failed", name);
+      if (!exists && fd != -1)
+        fail ("open \"%s\" succeeded after removal", name);
+      if (fd >= 2)
+        close (fd);
+    }
+}
+
+void
+test_main (void)
+{
+  char name[NAME_SIZE];
+  int i;
+
+  msg ("create %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      file_name (name, i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+
+  msg ("open each file");
+  check_files (0, 1, true);
+
+  msg ("remove every other file");
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      file_name (name, i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+
+  msg ("open each remaining file");
+  check_files (1, 2, true);
+  msg ("fail to open each removed file");
+  check_files (0, 2, false);
+
+  msg ("remove the rest");
+  for (i = 1; i < FILE_CNT; i += 2)
+    {
+      file_name (name, i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+  check_files (0, 1, false);
+}
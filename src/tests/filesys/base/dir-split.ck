@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-split) begin
+(dir-split) create 200 files
+(dir-split) open each file
+(dir-split) remove every other file
+(dir-split) open each remaining file
+(dir-split) fail to open each removed file
+(dir-split) remove the rest
+(dir-split) end
+EOF
+pass;
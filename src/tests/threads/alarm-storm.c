@@ -0,0 +1,108 @@
+/* Creates 1,000 threads that each wake up periodically with
+   timer_sleep_until(), with wakeups spread across every tick of
+   the period, and verifies that no thread wakes up early.  Then
+   reports the worst-case cost of the timer interrupt handler,
+   which should not grow with the number of sleeping threads. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 1000        /* Number of sleeping threads. */
+#define PERIOD 100              /* Ticks between wakeups of a thread. */
+#define ITERATIONS 3            /* Wakeups per thread. */
+
+/* Information about the test. */
+struct storm_test 
+  {
+    int64_t start;              /* Tick at which the first period starts. */
+    struct semaphore done;      /* Upped by each sleeper when done. */
+  };
+
+/* Information about an individual sleeper. */
+struct sleeper 
+  {
+    struct storm_test *test;    /* Info shared between all threads. */
+    int phase;                  /* Offset of wakeups within period. */
+    int early_cnt;              /* Number of early wakeups. */
+    int64_t max_late;           /* Latest wakeup, in ticks. */
+  };
+
+static thread_func sleeper;
+
+void
+test_alarm_storm (void) 
+{
+  struct storm_test test;
+  struct sleeper *sleepers;
+  int64_t max_late = 0;
+  int i;
+
+  msg ("Creating %d threads to wake up every %d ticks, %d times each.",
+       SLEEPER_CNT, PERIOD, ITERATIONS);
+
+  sleepers = malloc (sizeof *sleepers * SLEEPER_CNT);
+  if (sleepers == NULL)
+    PANIC ("couldn't allocate memory for test");
+
+  test.start = timer_ticks () + PERIOD;
+  sema_init (&test.done, 0);
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      struct sleeper *s = &sleepers[i];
+      char name[16];
+
+      s->test = &test;
+      s->phase = i % PERIOD;
+      s->early_cnt = 0;
+      s->max_late = 0;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, s) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&test.done);
+
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      if (sleepers[i].early_cnt > 0)
+        fail ("sleeper %d woke up early %d times",
+              i, sleepers[i].early_cnt);
+      if (sleepers[i].max_late > max_late)
+        max_late = sleepers[i].max_late;
+    }
+  msg ("All wakeups on time or late by at most %"PRId64" ticks.", max_late);
+  msg ("Slowest timer interrupt took %"PRIu64" cycles.",
+       timer_max_tick_cycles ());
+
+  free (sleepers);
+  pass ();
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *s_) 
+{
+  struct sleeper *s = s_;
+  int i;
+
+  for (i = 1; i <= ITERATIONS; i++) 
+    {
+      int64_t deadline = s->test->start + s->phase + i * PERIOD;
+      int64_t now;
+
+      timer_sleep_until (deadline);
+      now = timer_ticks ();
+      if (now < deadline)
+        s->early_cnt++;
+      else if (now - deadline > s->max_late)
+        s->max_late = now - deadline;
+    }
+  sema_up (&s->test->done);
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+
+# The expected output looks like this:
+#
+# (alarm-storm) begin
+# (alarm-storm) Creating 1000 threads to wake up every 100 ticks, 3 times each.
+# (alarm-storm) All wakeups on time or late by at most 1 ticks.
+# (alarm-storm) Slowest timer interrupt took 12345 cycles.
+# (alarm-storm) PASS
+# (alarm-storm) end
+#
+# The lateness and cycle counts vary from run to run.  An early
+# wakeup makes the test print a failure instead.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench_output ([
+    qr/^\(alarm-storm\) begin$/,
+    qr/^\(alarm-storm\) Creating 1000 threads to wake up every 100 ticks, 3 times each\.$/,
+    qr/^\(alarm-storm\) All wakeups on time or late by at most \d+ ticks\.$/,
+    qr/^\(alarm-storm\) Slowest timer interrupt took \d+ cycles\.$/,
+    qr/^\(alarm-storm\) PASS$/,
+    qr/^\(alarm-storm\) end$/]);
+
+pass;
@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Checks the output of a benchmark, whose numbers vary from run
+# to run, against @$EXPECTED, one pattern per line.  Returns a
+# reference to the list of groups captured from each line, for
+# any further checks.  The caller must still call pass.
+sub check_bench_output {
+    my ($expected) = @_;
+    our ($test);
+
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+
+    my (@captures);
+    for my $i (0...$#$expected) {
+	fail "Output ended early, before line " . ($i + 1) . ".\n"
+	  if $i > $#output;
+	my (@groups) = $output[$i] =~ $expected->[$i]
+	  or fail "Unexpected output line: $output[$i]\n";
+	push (@captures, \@groups);
+    }
+    fail "Unexpected output line: $output[@$expected]\n"
+      if @output > @$expected;
+    return @captures;
+}
+
+1;
@@ -0,0 +1,181 @@
+/* Measures the cost of the MLFQS fixed-point formulas.
+
+   First evaluates the load_avg, recent_cpu and priority formulas
+   over a range of inputs, once with out-of-line copies of the
+   original fixed-point routines, which divide 64-bit products by
+   FRACTION, and once with the inline operations in
+   threads/float_arith.h.  Verifies that the two agree closely
+   and reports the cycles each took.
+
+   Then keeps a set of threads busy for a few seconds, so that
+   the timer interrupt handler does its once-per-second MLFQS
+   updates, and reports the slowest invocation of the handler. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/float_arith.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ITERATIONS 1000         /* Evaluations of each formula. */
+#define BUSY_CNT 20             /* Busy threads for the handler test. */
+#define BUSY_SECONDS 3          /* How long they stay busy. */
+
+/* The original out-of-line routines. */
+static int NO_INLINE
+ref_f_mul_f (int f1, int f2)
+{
+  int64_t result = f1;
+  return result * f2 / FRACTION;
+}
+
+static int NO_INLINE
+ref_f_div_f (int f1, int f2)
+{
+  int64_t result = f1;
+  return result * FRACTION / f2;
+}
+
+static int NO_INLINE
+ref_f_add_i (int f, int i)
+{
+  return f + i * FRACTION;
+}
+
+static int NO_INLINE
+ref_i_mul_f (int i, int f)
+{
+  return i * f;
+}
+
+static int NO_INLINE
+ref_f_div_i (int f, int i)
+{
+  return f / i;
+}
+
+static int NO_INLINE
+ref_f_sub_f (int f1, int f2)
+{
+  return f1 - f2;
+}
+
+/* Formula results for one set of inputs. */
+struct result 
+  {
+    int load_avg;
+    int recent_cpu;
+    int priority;
+  };
+
+/* Evaluates the formulas with the original routines. */
+static void
+eval_ref (int load_avg, int recent_cpu, int nice, int ready,
+          struct result *r) 
+{
+  int coef;
+
+  r->load_avg = ref_f_div_i (ref_f_add_i (ref_i_mul_f (59, load_avg),
+                                          ready), 60);
+  coef = ref_f_div_f (ref_i_mul_f (2, load_avg),
+                      ref_f_add_i (ref_i_mul_f (2, load_avg), 1));
+  r->recent_cpu = ref_f_add_i (ref_f_mul_f (coef, recent_cpu), nice);
+  r->priority = ref_f_sub_f (
+    ref_f_sub_f (ref_f_add_i (0, PRI_MAX), ref_f_div_i (r->recent_cpu, 4)),
+    ref_i_mul_f (2, ref_f_add_i (0, nice))) / FRACTION;
+}
+
+/* Evaluates the formulas with the inline operations. */
+static void
+eval_inline (fixed_t load_avg, fixed_t recent_cpu, int nice, int ready,
+             struct result *r) 
+{
+  fixed_t coef;
+
+  r->load_avg = f_add_f (f_mul_f (F_CONST (59, 60), load_avg),
+                         i_mul_f (ready, F_CONST (1, 60)));
+  coef = f_div_f (i_mul_f (2, load_avg),
+                  f_add_i (i_mul_f (2, load_avg), 1));
+  r->recent_cpu = f_add_i (f_mul_f (coef, recent_cpu), nice);
+  r->priority = f_to_i (f_sub_i (i_sub_f (PRI_MAX,
+                                          f_div_i (r->recent_cpu, 4)),
+                                 2 * nice));
+}
+
+/* Fails unless A and B are within SLOP of each other. */
+static void
+check_close (const char *what, int a, int b, int slop) 
+{
+  if (a - b > slop || b - a > slop)
+    fail ("%s: %d with original routines, %d inline", what, a, b);
+}
+
+static thread_func busy;
+
+void
+test_fixed_point_bench (void) 
+{
+  uint64_t ref_cycles = 0, inline_cycles = 0;
+  int64_t end;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  msg ("Evaluating MLFQS formulas %d times each way.", ITERATIONS);
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      int load_avg = i * FRACTION / 16;
+      int recent_cpu = (i % 200 - 50) * FRACTION + i;
+      int nice = i % 41 - 20;
+      int ready = i % 64;
+      struct result ref, inl;
+      uint64_t start;
+
+      start = rdtsc ();
+      eval_ref (load_avg, recent_cpu, nice, ready, &ref);
+      ref_cycles += rdtsc () - start;
+
+      start = rdtsc ();
+      eval_inline (load_avg, recent_cpu, nice, ready, &inl);
+      inline_cycles += rdtsc () - start;
+
+      /* Rounding differs slightly: the inline version rounds
+         59/60 and 1/60 once, at compile time, and shifts rather
+         than divides, which rounds toward negative infinity. */
+      check_close ("load_avg", ref.load_avg, inl.load_avg, 1 + ready);
+      check_close ("recent_cpu", ref.recent_cpu, inl.recent_cpu, 2);
+      check_close ("priority", ref.priority, inl.priority, 1);
+    }
+  msg ("Original routines: %"PRIu64" cycles per evaluation.",
+       ref_cycles / ITERATIONS);
+  msg ("Inline operations: %"PRIu64" cycles per evaluation.",
+       inline_cycles / ITERATIONS);
+
+  msg ("Keeping %d threads busy for %d seconds.", BUSY_CNT, BUSY_SECONDS);
+  end = timer_ticks () + BUSY_SECONDS * TIMER_FREQ;
+  for (i = 0; i < BUSY_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "busy %d", i);
+      thread_create (name, PRI_DEFAULT, busy, &end);
+    }
+  timer_sleep_until (end + TIMER_FREQ);
+  msg ("Slowest timer interrupt took %"PRIu64" cycles.",
+       timer_max_tick_cycles ());
+
+  pass ();
+}
+
+/* Spins until the tick count in END_. */
+static void
+busy (void *end_) 
+{
+  int64_t *end = end_;
+
+  while (timer_ticks () < *end)
+    continue;
+}
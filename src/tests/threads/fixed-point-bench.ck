@@ -0,0 +1,33 @@
+# -*- perl -*-
+
+# The expected output looks like this:
+#
+# (fixed-point-bench) begin
+# (fixed-point-bench) Evaluating MLFQS formulas 1000 times each way.
+# (fixed-point-bench) Original routines: 456 cycles per evaluation.
+# (fixed-point-bench) Inline operations: 123 cycles per evaluation.
+# (fixed-point-bench) Keeping 20 threads busy for 3 seconds.
+# (fixed-point-bench) Slowest timer interrupt took 12345 cycles.
+# (fixed-point-bench) PASS
+# (fixed-point-bench) end
+#
+# The cycle counts vary from run to run.  If the two sets of
+# routines disagree, the test prints a failure instead of the
+# cycle counts.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench_output ([
+    qr/^\(fixed-point-bench\) begin$/,
+    qr/^\(fixed-point-bench\) Evaluating MLFQS formulas 1000 times each way\.$/,
+    qr/^\(fixed-point-bench\) Original routines: \d+ cycles per evaluation\.$/,
+    qr/^\(fixed-point-bench\) Inline operations: \d+ cycles per evaluation\.$/,
+    qr/^\(fixed-point-bench\) Keeping 20 threads busy for 3 seconds\.$/,
+    qr/^\(fixed-point-bench\) Slowest timer interrupt took \d+ cycles\.$/,
+    qr/^\(fixed-point-bench\) PASS$/,
+    qr/^\(fixed-point-bench\) end$/]);
+
+pass;
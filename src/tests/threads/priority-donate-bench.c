@@ -0,0 +1,140 @@
+/* Measures how long a high-priority thread waits for a lock held
+   by a low-priority thread while medium-priority threads keep
+   the CPU busy.
+
+   The low-priority thread holds the lock for CS_TICKS ticks of
+   busy work.  With priority donation it runs at the waiter's
+   priority and releases the lock about CS_TICKS ticks after the
+   request; without donation, the medium-priority threads starve
+   it and the waiter never gets the lock. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ROUNDS 10               /* Number of measurements. */
+#define CS_TICKS 2              /* Length of critical section, in ticks. */
+#define MEDIUM_CNT 3            /* Number of medium-priority threads. */
+
+/* State shared by the threads in the test. */
+struct bench 
+  {
+    struct lock lock;           /* The contended lock. */
+    struct semaphore go;        /* Tells the low thread to take the lock. */
+    struct semaphore held;      /* Signals that the lock is held. */
+    struct semaphore done;      /* Upped by each medium thread on exit. */
+    volatile bool stop;         /* Tells the medium threads to exit. */
+  };
+
+static thread_func low_thread;
+static thread_func medium_thread;
+
+void
+test_priority_donate_bench (void) 
+{
+  struct bench b;
+  uint64_t total_cycles = 0, max_cycles = 0;
+  int64_t max_ticks = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_init (&b.lock);
+  sema_init (&b.go, 0);
+  sema_init (&b.held, 0);
+  sema_init (&b.done, 0);
+  b.stop = false;
+
+  thread_set_priority (PRI_MAX);
+  thread_create ("low", PRI_MAX - 1, low_thread, &b);
+  for (i = 0; i < MEDIUM_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "medium %d", i);
+      thread_create (name, PRI_DEFAULT, medium_thread, &b);
+    }
+
+  msg ("Acquiring a lock held for %d ticks, %d times.", CS_TICKS, ROUNDS);
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      uint64_t start_cycles, cycles;
+      int64_t start_ticks, ticks;
+
+      sema_up (&b.go);
+      sema_down (&b.held);
+
+      start_cycles = rdtsc ();
+      start_ticks = timer_ticks ();
+      lock_acquire (&b.lock);
+      cycles = rdtsc () - start_cycles;
+      ticks = timer_elapsed (start_ticks);
+      lock_release (&b.lock);
+
+      total_cycles += cycles;
+      if (cycles > max_cycles)
+        max_cycles = cycles;
+      if (ticks > max_ticks)
+        max_ticks = ticks;
+    }
+
+  b.stop = true;
+  for (i = 0; i < MEDIUM_CNT; i++)
+    sema_down (&b.done);
+
+  msg ("Average wait: %"PRIu64" cycles.", total_cycles / ROUNDS);
+  msg ("Longest wait: %"PRIu64" cycles, %"PRId64" ticks.",
+       max_cycles, max_ticks);
+  if (max_ticks > CS_TICKS + 2)
+    fail ("waited %"PRId64" ticks for a %d-tick critical section",
+          max_ticks, CS_TICKS);
+  pass ();
+}
+
+/* Takes the lock when told to, drops to the lowest priority, and
+   does CS_TICKS ticks of work before releasing it. */
+static void
+low_thread (void *b_) 
+{
+  struct bench *b = b_;
+  int i;
+
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      int64_t start;
+
+      sema_down (&b->go);
+      lock_acquire (&b->lock);
+      sema_up (&b->held);
+
+      /* The main thread preempted us in sema_up() and is now
+         waiting for the lock.  Without its donation, we would
+         never run again at this priority. */
+      thread_set_priority (PRI_MIN);
+
+      start = timer_ticks ();
+      while (timer_elapsed (start) < CS_TICKS)
+        continue;
+
+      /* Restore our priority before releasing, so that we get to
+         run again for the next round. */
+      thread_set_priority (PRI_MAX - 1);
+      lock_release (&b->lock);
+    }
+}
+
+/* Keeps the CPU busy until told to stop. */
+static void
+medium_thread (void *b_) 
+{
+  struct bench *b = b_;
+
+  while (!b->stop)
+    continue;
+  sema_up (&b->done);
+}
@@ -0,0 +1,30 @@
+# -*- perl -*-
+
+# The expected output looks like this:
+#
+# (priority-donate-bench) begin
+# (priority-donate-bench) Acquiring a lock held for 2 ticks, 10 times.
+# (priority-donate-bench) Average wait: 1234567 cycles.
+# (priority-donate-bench) Longest wait: 2345678 cycles, 3 ticks.
+# (priority-donate-bench) PASS
+# (priority-donate-bench) end
+#
+# The cycle counts vary from run to run, but with priority
+# donation no wait may last more than 4 ticks.
+
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+my (@captures) = check_bench_output ([
+    qr/^\(priority-donate-bench\) begin$/,
+    qr/^\(priority-donate-bench\) Acquiring a lock held for 2 ticks, 10 times\.$/,
+    qr/^\(priority-donate-bench\) Average wait: \d+ cycles\.$/,
+    qr/^\(priority-donate-bench\) Longest wait: \d+ cycles, (\d+) ticks\.$/,
+    qr/^\(priority-donate-bench\) PASS$/,
+    qr/^\(priority-donate-bench\) end$/]);
+fail "Longest wait of $captures[3][0] ticks exceeds 4 ticks.\n"
+  if $captures[3][0] > 4;
+
+pass;
@@ -17,6 +17,7 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-storm", test_alarm_storm},
     {"priority-change", test_priority_change},
     {"priority-change-2", test_priority_change_2},
     {"priority-donate-one", test_priority_donate_one},
@@ -26,6 +27,7 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-bench", test_priority_donate_bench},
     {"priority-fifo", test_priority_fifo},
     {"priority-lifo", test_priority_lifo},
     {"priority-preempt", test_priority_preempt},
@@ -41,6 +43,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"fixed-point-bench", test_fixed_point_bench},
   };
 
 static const char *test_name;
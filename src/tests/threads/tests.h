@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_storm;
 extern test_func test_priority_change;
 extern test_func test_priority_change_2;
 extern test_func test_priority_donate_one;
@@ -20,6 +21,7 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_bench;
 extern test_func test_priority_fifo;
 extern test_func test_priority_lifo;
 extern test_func test_priority_preempt;
@@ -35,6 +37,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_fixed_point_bench;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -1,19 +1,86 @@
 #ifndef __FLOAT_ARITH_H
 #define __FLOAT_ARITH_H
 
-#include <inttypes.h>
-
-#define FRACTION (1 << 14)
-
-int i_add_f(int i, int f);
-int i_sub_f(int i, int f);
-int i_mul_f(int i, int f);
-int f_add_i(int f, int i);
-int f_sub_i(int f, int i);
-int f_mul_f(int f1, int f2);
-int f_div_f(int f1, int f2);
-int f_add_f(int f1, int f2);
-int f_sub_f(int f1, int f2);
-int f_div_i(int f, int i);
+/* 17.14 fixed-point arithmetic for the MLFQS scheduler.
+
+   A fixed_t represents the real number X as the integer
+   X * FRACTION.  The operations are named for the types of their
+   operands: `f' for fixed_t, `i' for int.  They are all inline.
+   Products are formed in 64 bits and scaled back down with a
+   shift, so only f_div_f needs a 64-bit division, which on i386
+   is a call to __divdi3 in lib/arithmetic.c. */
+
+#include <stdint.h>
+
+typedef int32_t fixed_t;
+
+#define FRACTION_BITS 14
+#define FRACTION (1 << FRACTION_BITS)
+
+/* The fraction N/D as a fixed_t, rounded to nearest.  This is a
+   constant expression when N and D are. */
+#define F_CONST(N, D) \
+        ((fixed_t) (((int64_t) (N) * FRACTION + (D) / 2) / (D)))
+
+static inline fixed_t
+i_sub_f (int i, fixed_t f)
+{
+  return i * FRACTION - f;
+}
+
+static inline fixed_t
+i_mul_f (int i, fixed_t f)
+{
+  return i * f;
+}
+
+static inline fixed_t
+f_add_i (fixed_t f, int i)
+{
+  return f + i * FRACTION;
+}
+
+static inline fixed_t
+f_sub_i (fixed_t f, int i)
+{
+  return f - i * FRACTION;
+}
+
+static inline fixed_t
+f_mul_f (fixed_t f1, fixed_t f2)
+{
+  return (fixed_t) (((int64_t) f1 * f2) >> FRACTION_BITS);
+}
+
+static inline fixed_t
+f_div_f (fixed_t f1, fixed_t f2)
+{
+  return (fixed_t) (((int64_t) f1 << FRACTION_BITS) / f2);
+}
+
+static inline fixed_t
+f_add_f (fixed_t f1, fixed_t f2)
+{
+  return f1 + f2;
+}
+
+static inline fixed_t
+f_sub_f (fixed_t f1, fixed_t f2)
+{
+  return f1 - f2;
+}
+
+static inline fixed_t
+f_div_i (fixed_t f, int i)
+{
+  return f / i;
+}
+
+/* Converts F to an integer, rounding toward zero. */
+static inline int
+f_to_i (fixed_t f)
+{
+  return f / FRACTION;
+}
 
 #endif
@@ -21,6 +21,7 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -34,9 +35,16 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/fpage.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -63,6 +71,7 @@ static void paging_init (void);
 static char **read_command_line (void);
 static char **parse_options (char **argv);
 static void run_actions (char **argv);
+static void print_lock_stats (char **argv);
 static void usage (void);
 
 #ifdef FILESYS
@@ -127,6 +136,13 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  swap_init ();
+  fpage_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -247,15 +263,36 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-dma"))
+        ide_dma = true;
+      else if (!strcmp (name, "-iosched"))
+        {
+          if (!ide_set_scheduler (value))
+            PANIC ("unknown I/O scheduler `%s' (use -h for help)", value);
+        }
+      else if (!strcmp (name, "-flush-interval"))
+        cache_flush_interval = atoi (value);
+      else if (!strcmp (name, "-flush-age"))
+        cache_max_dirty_age = atoi (value);
+      else if (!strcmp (name, "-dirty-high"))
+        cache_dirty_high = atoi (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-stack-max"))
+        stack_max_pages = atoi (value);
+      else if (!strcmp (name, "-stack-prefault"))
+        stack_prefault_pages = atoi (value);
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-tcache"))
+        thread_cache_max = atoi (value);
 #ifndef USERPROG
       /* Project #3. */
       else if (!strcmp (name, "-aging"))
@@ -297,6 +334,14 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Prints contention statistics for the kernel's instrumented
+   locks. */
+static void
+print_lock_stats (char **argv UNUSED) 
+{
+  lock_stats_print ();
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -314,6 +359,7 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"lockstat", 1, print_lock_stats},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -362,6 +408,7 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  lockstat           Print lock contention statistics.\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -378,12 +425,22 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -dma               Use bus-master DMA for IDE disks.\n"
+          "  -iosched=POLICY    Order disk requests by POLICY: fifo, clook,\n"
+          "                     or deadline (the default).\n"
+          "  -flush-interval=N  Wake the cache flusher every N ticks.\n"
+          "  -flush-age=N       Write back data dirty for N ticks or more.\n"
+          "  -dirty-high=N      Throttle writers above N dirty sectors.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -stack-max=N       Let user stacks grow to N pages.\n"
+          "  -stack-prefault=N  Map N more pages on each stack growth fault.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the timer tick while the CPU is idle.\n"
+          "  -tcache=N          Keep up to N freed thread pages for reuse.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -27,11 +27,19 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+static heap_less_func waiter_less;
+
+/* Next wait_seq to hand out, so that waiters of equal priority
+   are woken in the order they began to wait. */
+static uint64_t wait_seq;
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -47,7 +55,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,7 +76,11 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      struct thread *cur = thread_current ();
+
+      cur->wait_seq = wait_seq++;
+      cur->waiting_sema = sema;
+      heap_insert (&sema->waiters, &cur->wait_elem);
       thread_block ();
     }
   sema->value--;
@@ -102,38 +114,50 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any.  Yields the CPU if that thread has a higher
+   priority than the running thread.
 
    This function may be called from an interrupt handler. */
 void
 sema_up (struct semaphore *sema) 
 {
   enum intr_level old_level;
+  struct thread *t = NULL;
 
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) {
-      struct list_elem *e, *max_e;
-      e = list_begin(&sema->waiters);
-      struct thread *t, *max_t = list_entry(e, struct thread, elem);
-      max_e = e;
-      for(e = list_next(e); e != list_end(&sema->waiters) ; e = list_next(e)) {
-          t = list_entry(e, struct thread, elem);
-          if(max_t->priority < t->priority) {
-              max_t = t;
-              max_e = e;
-          }
-      }
-      list_remove(max_e);
-      thread_unblock(max_t);
-    /*thread_unblock (list_entry (list_pop_front (&sema->waiters),*/
-                                /*struct thread, elem));*/
-  }
+  if (!heap_empty (&sema->waiters)) 
+    {
+      t = heap_entry (heap_pop_min (&sema->waiters), struct thread,
+                      wait_elem);
+      t->waiting_sema = NULL;
+      thread_unblock (t);
+    }
   sema->value++;
+  if (t != NULL && t->priority > thread_current ()->priority) 
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
   intr_set_level (old_level);
+}
+
+/* Orders semaphore waiters by descending priority, then by the
+   order in which they began to wait. */
+static bool
+waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+             void *aux UNUSED) 
+{
+  const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+  const struct thread *b = heap_entry (b_, struct thread, wait_elem);
 
-  thread_yield();
+  if (a->priority != b->priority)
+    return a->priority > b->priority;
+  return a->wait_seq < b->wait_seq;
 }
 
 static void sema_test_helper (void *sema_);
@@ -201,6 +225,12 @@ lock_init (struct lock *lock)
    necessary.  The lock must not already be held by the current
    thread.
 
+   While waiting, the current thread donates its priority to the
+   lock's holder, and onward to the holder of any lock that the
+   holder is itself waiting for, through at most
+   MAX_DONATION_DEPTH locks.  The MLFQS scheduler does not use
+   donation.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -208,12 +238,35 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (lock->holder != NULL && !thread_mlfqs) 
+    {
+      struct lock *l = lock;
+      int depth;
+
+      cur->waiting_lock = lock;
+      for (depth = 0; l != NULL && l->holder != NULL
+             && depth < MAX_DONATION_DEPTH; depth++) 
+        {
+          if (l->holder->priority >= cur->priority)
+            break;
+          thread_donate_priority (l->holder, cur->priority);
+          l = l->holder->waiting_lock;
+        }
+    }
+
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->held_locks, &lock->elem);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -225,18 +278,25 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
-  if (success)
-    lock->holder = thread_current ();
+  if (success) 
+    {
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->held_locks, &lock->elem);
+    }
+  intr_set_level (old_level);
   return success;
 }
 
-/* Releases LOCK, which must be owned by the current thread.
+/* Releases LOCK, which must be owned by the current thread, and
+   gives up any priority that was donated through it.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -244,11 +304,18 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   lock->holder = NULL;
+  list_remove (&lock->elem);
+  if (!thread_mlfqs)
+    thread_refresh_priority ();
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -267,6 +334,7 @@ struct semaphore_elem
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
 /* Initializes condition variable COND.  A condition variable
@@ -311,6 +379,7 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -318,7 +387,8 @@ cond_wait (struct condition *cond, struct lock *lock)
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
+   this function signals the one with the highest priority to
+   wake up from its wait.
    LOCK must be held before calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -333,8 +403,21 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct semaphore_elem *max = NULL;
+      struct list_elem *e;
+
+      for (e = list_begin (&cond->waiters); e != list_end (&cond->waiters);
+           e = list_next (e)) 
+        {
+          struct semaphore_elem *w = list_entry (e, struct semaphore_elem,
+                                                 elem);
+          if (max == NULL || w->thread->priority > max->thread->priority)
+            max = w;
+        }
+      list_remove (&max->elem);
+      sema_up (&max->semaphore);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -352,3 +435,331 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Registered lock statistics, for lock_stats_print(). */
+static struct list registry;
+static struct lock registry_lock;
+static bool registry_ready;
+
+static void
+registry_acquire (void)
+{
+  enum intr_level old_level = intr_disable ();
+  if (!registry_ready) 
+    {
+      list_init (&registry);
+      lock_init (&registry_lock);
+      registry_ready = true;
+    }
+  intr_set_level (old_level);
+  lock_acquire (&registry_lock);
+}
+
+/* Initializes STATS to zero counts.  STATS is not registered. */
+void
+lock_stats_init (struct lock_stats *stats)
+{
+  ASSERT (stats != NULL);
+
+  stats->name[0] = '\0';
+  stats->acquire_cnt = 0;
+  stats->contended_cnt = 0;
+  stats->wait_ticks = 0;
+  stats->registered = false;
+}
+
+/* Names STATS NAME and adds it to the statistics printed by
+   lock_stats_print().  STATS must be unregistered before the
+   lock that contains it is freed. */
+void
+lock_stats_register (struct lock_stats *stats, const char *name)
+{
+  ASSERT (stats != NULL);
+  ASSERT (!stats->registered);
+
+  strlcpy (stats->name, name, sizeof stats->name);
+  registry_acquire ();
+  list_push_back (&registry, &stats->elem);
+  stats->registered = true;
+  lock_release (&registry_lock);
+}
+
+/* Removes STATS from the statistics printed by
+   lock_stats_print(), if it is there. */
+void
+lock_stats_unregister (struct lock_stats *stats)
+{
+  ASSERT (stats != NULL);
+
+  if (stats->registered) 
+    {
+      registry_acquire ();
+      list_remove (&stats->elem);
+      stats->registered = false;
+      lock_release (&registry_lock);
+    }
+}
+
+/* Adds the counts in SRC to DST, so that one registered entry can
+   stand for many short-lived locks. */
+void
+lock_stats_add (struct lock_stats *dst, const struct lock_stats *src)
+{
+  ASSERT (dst != NULL && src != NULL);
+
+  dst->acquire_cnt += src->acquire_cnt;
+  dst->contended_cnt += src->contended_cnt;
+  dst->wait_ticks += src->wait_ticks;
+}
+
+/* Prints the statistics of each registered lock. */
+void
+lock_stats_print (void)
+{
+  struct list_elem *e;
+
+  registry_acquire ();
+  printf ("%-16s %12s %12s %12s\n",
+          "Lock", "Acquired", "Contended", "Wait ticks");
+  for (e = list_begin (&registry); e != list_end (&registry);
+       e = list_next (e)) 
+    {
+      struct lock_stats *stats = list_entry (e, struct lock_stats, elem);
+      printf ("%-16s %12llu %12llu %12"PRId64"\n", stats->name,
+              stats->acquire_cnt, stats->contended_cnt, stats->wait_ticks);
+    }
+  lock_release (&registry_lock);
+}
+
+/* Number of times an adaptive lock waits for a holder that is
+   making progress before it goes to sleep. */
+#define ADAPTIVE_SPIN_CNT 16
+
+/* Initializes adaptive lock AL. */
+void
+adaptive_lock_init (struct adaptive_lock *al)
+{
+  ASSERT (al != NULL);
+
+  lock_init (&al->lock);
+  lock_stats_init (&al->stats);
+}
+
+/* Acquires AL, sleeping until it becomes available if necessary.
+   AL must not already be held by the current thread.
+
+   If AL is held, waits for the holder to release it for a while
+   before sleeping, as long as the holder is running on another
+   CPU, or is ready to run ahead of the current thread, in which
+   case the current thread yields to it.  Pintos runs on a single
+   CPU, so in practice the holder is never running and the wait
+   consists of yields.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+adaptive_lock_acquire (struct adaptive_lock *al)
+{
+  struct thread *cur = thread_current ();
+  int64_t start;
+  int spin;
+
+  ASSERT (al != NULL);
+  ASSERT (!intr_context ());
+
+  if (lock_try_acquire (&al->lock)) 
+    {
+      al->stats.acquire_cnt++;
+      return;
+    }
+
+  start = timer_ticks ();
+  for (spin = 0; spin < ADAPTIVE_SPIN_CNT; spin++) 
+    {
+      enum intr_level old_level = intr_disable ();
+      struct thread *holder = al->lock.holder;
+      bool progress = (holder == NULL
+                       || holder->status == THREAD_RUNNING
+                       || (holder->status == THREAD_READY
+                           && holder->priority >= cur->priority));
+      if (holder != NULL && holder->status == THREAD_READY && progress)
+        thread_yield ();
+      intr_set_level (old_level);
+
+      if (!progress)
+        break;
+      if (lock_try_acquire (&al->lock))
+        goto done;
+    }
+  lock_acquire (&al->lock);
+
+ done:
+  al->stats.acquire_cnt++;
+  al->stats.contended_cnt++;
+  al->stats.wait_ticks += timer_elapsed (start);
+}
+
+/* Tries to acquire AL and returns true if successful or false
+   on failure.  AL must not already be held by the current
+   thread. */
+bool
+adaptive_lock_try_acquire (struct adaptive_lock *al)
+{
+  ASSERT (al != NULL);
+
+  if (!lock_try_acquire (&al->lock))
+    return false;
+  al->stats.acquire_cnt++;
+  return true;
+}
+
+/* Releases AL, which must be owned by the current thread. */
+void
+adaptive_lock_release (struct adaptive_lock *al)
+{
+  ASSERT (al != NULL);
+
+  lock_release (&al->lock);
+}
+
+/* Returns true if the current thread holds AL, false
+   otherwise. */
+bool
+adaptive_lock_held_by_current_thread (const struct adaptive_lock *al)
+{
+  ASSERT (al != NULL);
+
+  return lock_held_by_current_thread (&al->lock);
+}
+
+/* Initializes readers-writer lock RW. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  cond_init (&rw->can_read);
+  cond_init (&rw->can_write);
+  rw->reader_cnt = 0;
+  rw->writer = NULL;
+  rw->waiting_readers = 0;
+  rw->waiting_writers = 0;
+  rw->handoff_cnt = 0;
+  rw->handoff_gen = 0;
+  lock_stats_init (&rw->stats);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or,
+   unless the last writer handed the lock to us, while a writer
+   is waiting for it.  Only readers that were already waiting
+   when a writer released the lock share in its handoff; a reader
+   that arrives later waits behind the waiting writers.  This
+   function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  rw->stats.acquire_cnt++;
+  if (rw->writer != NULL || rw->waiting_writers > 0) 
+    {
+      int64_t start = timer_ticks ();
+      unsigned gen = rw->handoff_gen;
+
+      rw->stats.contended_cnt++;
+      rw->waiting_readers++;
+      while (rw->writer != NULL
+             || (rw->waiting_writers > 0 && rw->handoff_gen == gen))
+        cond_wait (&rw->can_read, &rw->lock);
+      rw->waiting_readers--;
+
+      /* A handoff counted us, and no writer can take the lock
+         until every reader it counted has entered. */
+      if (rw->handoff_gen != gen)
+        {
+          ASSERT (rw->handoff_cnt > 0);
+          rw->handoff_cnt--;
+        }
+      rw->stats.wait_ticks += timer_elapsed (start);
+    }
+  rw->reader_cnt++;
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->reader_cnt > 0);
+  if (--rw->reader_cnt == 0 && rw->handoff_cnt == 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no reader or writer
+   holds it.  This function may sleep, so it must not be called
+   within an interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  rw->stats.acquire_cnt++;
+  if (rw->writer != NULL || rw->reader_cnt > 0 || rw->handoff_cnt > 0) 
+    {
+      int64_t start = timer_ticks ();
+
+      rw->stats.contended_cnt++;
+      rw->waiting_writers++;
+      while (rw->writer != NULL || rw->reader_cnt > 0
+             || rw->handoff_cnt > 0)
+        cond_wait (&rw->can_write, &rw->lock);
+      rw->waiting_writers--;
+      rw->stats.wait_ticks += timer_elapsed (start);
+    }
+  rw->writer = thread_current ();
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for writing.
+   If readers are waiting, hands the lock to all of the readers
+   waiting at this moment, even if other writers are also
+   waiting; otherwise wakes one writer. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_write (rw));
+
+  lock_acquire (&rw->lock);
+  rw->writer = NULL;
+  if (rw->waiting_readers > 0) 
+    {
+      rw->handoff_cnt = rw->waiting_readers;
+      rw->handoff_gen++;
+      cond_broadcast (&rw->can_read, &rw->lock);
+    }
+  else
+    cond_signal (&rw->can_write, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing,
+   false otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
@@ -1,14 +1,16 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, highest priority first. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -20,10 +22,14 @@ void sema_self_test (void);
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
   };
 
+/* Most locks that a priority donation passes through. */
+#define MAX_DONATION_DEPTH 8
+
 void lock_init (struct lock *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
@@ -41,6 +47,66 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Contention statistics for one lock. */
+struct lock_stats
+  {
+    char name[16];              /* Name, for lock_stats_print(). */
+    unsigned long long acquire_cnt;     /* Number of acquisitions. */
+    unsigned long long contended_cnt;   /* Acquisitions that waited. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+    struct list_elem elem;      /* Element in list of registered stats. */
+    bool registered;            /* In list of registered stats? */
+  };
+
+void lock_stats_init (struct lock_stats *);
+void lock_stats_register (struct lock_stats *, const char *name);
+void lock_stats_unregister (struct lock_stats *);
+void lock_stats_add (struct lock_stats *, const struct lock_stats *);
+void lock_stats_print (void);
+
+/* Adaptive lock.
+   Like a lock, but a thread that finds it held first waits a
+   little while for the holder to release it, as long as the
+   holder is making progress, before it sleeps. */
+struct adaptive_lock
+  {
+    struct lock lock;           /* Underlying lock. */
+    struct lock_stats stats;    /* Contention statistics. */
+  };
+
+void adaptive_lock_init (struct adaptive_lock *);
+void adaptive_lock_acquire (struct adaptive_lock *);
+bool adaptive_lock_try_acquire (struct adaptive_lock *);
+void adaptive_lock_release (struct adaptive_lock *);
+bool adaptive_lock_held_by_current_thread (const struct adaptive_lock *);
+
+/* Readers-writer lock.
+   Any number of readers may hold the lock at once, or a single
+   writer.  Waiting writers keep new readers out, but a writer
+   that releases the lock hands it to the readers that were
+   already waiting before any other writer gets it, so neither
+   side can starve the other. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition can_read;  /* Signaled when readers may enter. */
+    struct condition can_write; /* Signaled when the lock is free. */
+    int reader_cnt;             /* Number of readers holding the lock. */
+    struct thread *writer;      /* Writer holding the lock, if any. */
+    int waiting_readers;        /* Number of readers waiting. */
+    int waiting_writers;        /* Number of writers waiting. */
+    int handoff_cnt;            /* Readers admitted ahead of writers. */
+    unsigned handoff_gen;       /* Number of handoffs to readers. */
+    struct lock_stats stats;    /* Contention statistics. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -1,16 +1,18 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <limits.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/vaddr.h"
-#include "threads/float_arith.c"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -20,9 +22,14 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO list
+   per priority, and bit P of ready_mask is set when list P is
+   nonempty, so that enqueueing and finding the highest-priority
+   ready thread both take constant time. */
+static struct list ready_lists[PRI_MAX + 1];
+static uint64_t ready_mask;
+static int ready_cnt;           /* Number of ready threads. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -50,23 +57,59 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Wakeup-to-run latency histogram.  See lib/schedstat.h. */
+static uint64_t wakeup_latency[SCHEDSTAT_BUCKETS];
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
-#ifndef USERPROG
 /* Project #3. */
 bool thread_prior_aging;
-#endif
 
-static int load_avg;
+static fixed_t load_avg;
+
+/* Weights of the old load_avg and of each ready thread in the
+   new load_avg. */
+#define LOAD_AVG_DECAY F_CONST (59, 60)
+#define LOAD_AVG_WEIGHT F_CONST (1, 60)
+
+/* Once a second, every thread's recent_cpu decays by a factor
+   that depends on load_avg.  The factor is computed once, and
+   the threads are then decayed DECAY_BATCH at a time on each
+   following tick by walking all_list from decay_cursor.  A
+   thread's decay_epoch records the last second whose decay it
+   has received, so a thread that runs before the sweep reaches
+   it is brought up to date first. */
+#define DECAY_BATCH 8
+static fixed_t decay_coef;              /* (2*load_avg)/(2*load_avg+1). */
+static unsigned decay_epoch;            /* Seconds of decay so far. */
+static struct list_elem *decay_cursor;  /* Next thread to decay, or NULL. */
+
+/* Threads whose recent_cpu or nice changed since their priority
+   was last computed. */
+static struct list dirty_list;
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Pages of dead threads kept for reuse by thread_create(), which
+   then only needs to clear the struct thread at the bottom
+   instead of taking the pool lock and zeroing a whole page.
+   Pintos has one CPU, so one cache serves as the per-CPU cache.
+   The pages form a stack linked through their first word.
+   Interrupts must be off to touch these. */
+int thread_cache_max = 8;               /* High-water mark. */
+static void *thread_cache;              /* Most recently freed page. */
+static int thread_cache_cnt;            /* Pages in the cache. */
+static long long thread_cache_hits;     /* Allocations from the cache. */
+static long long thread_cache_misses;   /* Allocations from palloc. */
+
 static void kernel_thread (thread_func *, void *aux);
+static struct thread *alloc_thread (void);
+static void free_thread (struct thread *);
 
 static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
@@ -78,8 +121,13 @@ static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 
-bool priority_less_func(const struct list_elem* left,
-        const struct list_elem* right, void* aux);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static void set_priority (struct thread *, int priority);
+static void decay_recent_cpu (struct thread *);
+static void decay_step (int cnt);
+static void mark_dirty (struct thread *);
+static int compute_priority (const struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -97,12 +145,18 @@ bool priority_less_func(const struct list_elem* left,
     void
 thread_init (void) 
 {
+    int i;
+
     ASSERT (intr_get_level () == INTR_OFF);
 
     load_avg = 0;
     lock_init (&tid_lock);
-    list_init (&ready_list);
+    for (i = 0; i <= PRI_MAX; i++)
+        list_init (&ready_lists[i]);
+    ready_mask = 0;
+    ready_cnt = 0;
     list_init (&all_list);
+    list_init (&dirty_list);
 
     /* Set up a thread structure for the running thread. */
     initial_thread = running_thread ();
@@ -138,6 +192,7 @@ thread_tick (void)
     struct thread *t = thread_current ();
 
     /* Update statistics. */
+    t->run_ticks++;
     if (t == idle_thread)
         idle_ticks++;
 #ifdef USERPROG
@@ -163,6 +218,53 @@ thread_print_stats (void)
 {
     printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
             idle_ticks, kernel_ticks, user_ticks);
+    if (timer_tickless)
+    {
+        long long skipped = timer_skipped_ticks ();
+        long long total = idle_ticks + kernel_ticks + user_ticks + skipped;
+
+        printf ("Tickless: %lld ticks skipped, %lld%% idle residency\n",
+                skipped, total > 0 ? (idle_ticks + skipped) * 100 / total : 0);
+    }
+    printf ("Thread cache: %lld hits, %lld misses, %d of %d pages cached\n",
+            thread_cache_hits, thread_cache_misses,
+            thread_cache_cnt, thread_cache_max);
+}
+
+/* Stores CPU accounting for up to MAX threads into STATS and
+   returns the number stored.  If HIST is nonnull, also
+   copies the wakeup-to-run latency histogram into it. */
+    int
+thread_get_stats (struct thread_stat *stats, int max,
+                  uint64_t hist[SCHEDSTAT_BUCKETS]) 
+{
+    enum intr_level old_level;
+    struct list_elem *e;
+    int cnt = 0;
+
+    old_level = intr_disable ();
+    for (e = list_begin (&all_list); e != list_end (&all_list) && cnt < max;
+         e = list_next (e))
+    {
+        struct thread *t = list_entry (e, struct thread, allelem);
+        struct thread_stat *s = &stats[cnt++];
+
+        s->tid = t->tid;
+        strlcpy (s->name, t->name, sizeof s->name);
+        s->status = t->status;
+        s->priority = t->priority;
+        s->run_ticks = t->run_ticks;
+        s->voluntary_cnt = t->voluntary_cnt;
+        s->involuntary_cnt = t->involuntary_cnt;
+        s->ready_cycles = t->ready_cycles;
+        if (t->ready_since != 0)
+            s->ready_cycles += rdtsc () - t->ready_since;
+    }
+    if (hist != NULL)
+        memcpy (hist, wakeup_latency, sizeof wakeup_latency);
+    intr_set_level (old_level);
+
+    return cnt;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -193,7 +295,7 @@ thread_create (const char *name, int priority,
     ASSERT (function != NULL);
 
     /* Allocate thread. */
-    t = palloc_get_page (PAL_ZERO);
+    t = alloc_thread ();
     if (t == NULL)
         return TID_ERROR;
 
@@ -238,6 +340,7 @@ thread_block (void)
     ASSERT (intr_get_level () == INTR_OFF);
 
     thread_current ()->status = THREAD_BLOCKED;
+    thread_current ()->voluntary_cnt++;
     schedule ();
 }
 
@@ -258,8 +361,9 @@ thread_unblock (struct thread *t)
 
     old_level = intr_disable ();
     ASSERT (t->status == THREAD_BLOCKED);
-    list_insert_ordered(&ready_list, &t->elem, priority_less_func, NULL);
-    /*list_push_back (&ready_list, &t->elem);*/
+    t->ready_since = rdtsc ();
+    t->woken = true;
+    ready_push (t);
     t->status = THREAD_READY;
     intr_set_level (old_level);
 }
@@ -312,7 +416,11 @@ thread_exit (void)
        and schedule another process.  That process will destroy us
        when it calls thread_schedule_tail(). */
     intr_disable ();
+    if (decay_cursor == &thread_current()->allelem)
+        decay_cursor = list_next (decay_cursor);
     list_remove (&thread_current()->allelem);
+    if (thread_current()->dirty)
+        list_remove (&thread_current()->dirty_elem);
     thread_current ()->status = THREAD_DYING;
     schedule ();
     NOT_REACHED ();
@@ -330,17 +438,183 @@ thread_yield (void)
 
     old_level = intr_disable ();
     if (cur != idle_thread) 
-        list_insert_ordered(&ready_list, &cur->elem, priority_less_func, NULL);
-        //list_push_back (&ready_list, &cur->elem);
+    {
+        cur->ready_since = rdtsc ();
+        cur->woken = false;
+        ready_push (cur);
+    }
+    cur->involuntary_cnt++;
     cur->status = THREAD_READY;
     schedule ();
     intr_set_level (old_level);
 }
 
-bool priority_less_func(const struct list_elem* left,
-        const struct list_elem* right, void* aux) {
-    return list_entry(left, struct thread, elem)->priority
-        > list_entry(right, struct thread, elem)->priority;
+/* Returns a page for a new thread, taking it from the thread
+   cache if possible.  Only the page's struct thread is known to
+   be zeroed; init_thread() initializes the rest of what a thread
+   relies on. */
+static struct thread *
+alloc_thread (void)
+{
+    enum intr_level old_level;
+    struct thread *t;
+
+    old_level = intr_disable ();
+    t = thread_cache;
+    if (t != NULL)
+    {
+        thread_cache = *(void **) t;
+        thread_cache_cnt--;
+        thread_cache_hits++;
+    }
+    else
+        thread_cache_misses++;
+    intr_set_level (old_level);
+
+    if (t != NULL)
+        memset (t, 0, sizeof *t);
+    else
+        t = palloc_get_page (PAL_ZERO);
+    return t;
+}
+
+/* Frees the page of dead thread T, keeping it in the thread cache
+   unless the cache is at its high-water mark.
+   Interrupts must be off. */
+static void
+free_thread (struct thread *t)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    if (thread_cache_cnt < thread_cache_max)
+    {
+        /* Stale pointers to T must not pass is_thread(). */
+        t->magic = 0;
+        *(void **) t = thread_cache;
+        thread_cache = t;
+        thread_cache_cnt++;
+    }
+    else
+        palloc_free_page (t);
+}
+
+/* Returns the index of the most significant set bit in X, which
+   must be nonzero.  See [IA32-v2a] "BSR". */
+static inline int
+highest_bit (uint32_t x)
+{
+    int bit;
+    asm ("bsrl %1, %0" : "=r" (bit) : "rm" (x));
+    return bit;
+}
+
+/* Returns the latency histogram bucket for a wait of CYCLES. */
+static int
+latency_bucket (uint64_t cycles)
+{
+    uint32_t high = cycles >> 32;
+    int bucket;
+
+    if (high != 0)
+        bucket = 32 + highest_bit (high);
+    else if (cycles != 0)
+        bucket = highest_bit ((uint32_t) cycles);
+    else
+        bucket = 0;
+    return bucket < SCHEDSTAT_BUCKETS ? bucket : SCHEDSTAT_BUCKETS - 1;
+}
+
+/* Appends T to the ready queue for its priority.
+   Interrupts must be off. */
+static void
+ready_push (struct thread *t)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    list_push_back (&ready_lists[t->priority], &t->elem);
+    ready_mask |= (uint64_t) 1 << t->priority;
+    ready_cnt++;
+}
+
+/* Removes T from the ready queue for its priority.
+   Interrupts must be off. */
+static void
+ready_remove (struct thread *t)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    list_remove (&t->elem);
+    if (list_empty (&ready_lists[t->priority]))
+        ready_mask &= ~((uint64_t) 1 << t->priority);
+    ready_cnt--;
+}
+
+/* Sets T's priority to PRIORITY, moving T to the matching ready
+   queue if it is ready to run, or within the wait queue of the
+   semaphore it is blocked on.  Interrupts must be off. */
+static void
+set_priority (struct thread *t, int priority)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    if (t->priority == priority)
+        return;
+    if (t->status == THREAD_READY)
+    {
+        ready_remove (t);
+        t->priority = priority;
+        ready_push (t);
+    }
+    else if (t->status == THREAD_BLOCKED && t->waiting_sema != NULL)
+    {
+        struct heap *waiters = &t->waiting_sema->waiters;
+
+        heap_remove (waiters, &t->wait_elem);
+        t->priority = priority;
+        heap_insert (waiters, &t->wait_elem);
+    }
+    else
+        t->priority = priority;
+}
+
+/* Raises T's priority to PRIORITY, if it is lower, on behalf of
+   a thread waiting for a lock that T holds.  Interrupts must be
+   off. */
+void
+thread_donate_priority (struct thread *t, int priority)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    if (priority > t->priority)
+        set_priority (t, priority);
+}
+
+/* Recomputes the running thread's priority as the higher of its
+   base priority and the priority of the highest-priority thread
+   waiting on any lock that it holds.  Interrupts must be off. */
+void
+thread_refresh_priority (void)
+{
+    struct thread *cur = thread_current ();
+    int priority = cur->base_priority;
+    struct list_elem *e;
+
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    for (e = list_begin (&cur->held_locks); e != list_end (&cur->held_locks);
+         e = list_next (e))
+    {
+        struct lock *lock = list_entry (e, struct lock, elem);
+        struct heap_elem *top = heap_min (&lock->semaphore.waiters);
+
+        if (top != NULL)
+        {
+            struct thread *t = heap_entry (top, struct thread, wait_elem);
+            if (t->priority > priority)
+                priority = t->priority;
+        }
+    }
+    set_priority (cur, priority);
 }
 
 /* Invoke function 'func' on all threads, passing along 'aux'.
@@ -363,12 +637,16 @@ thread_foreach (thread_action_func *func, void *aux)
 /* Sets the current thread's priority to NEW_PRIORITY. */
     void
 thread_set_priority (int new_priority) {
+    enum intr_level old_level;
+
     if(thread_mlfqs) return;
 
-    int prev = thread_current()->priority;
+    old_level = intr_disable();
+    thread_current ()->base_priority = new_priority;
+    thread_refresh_priority();
+    intr_set_level(old_level);
 
-    thread_current ()->priority = new_priority;
-    if(new_priority < prev)
+    if(thread_current ()->priority < get_max_priority())
         thread_yield();
 }
 
@@ -382,18 +660,13 @@ thread_get_priority (void) {
     void
 thread_set_nice (int nice UNUSED) {
     struct thread* t = thread_current();
+    enum intr_level old_level = intr_disable();
 
+    decay_recent_cpu(t);
     t->nice = nice;
-    t->priority = f_sub_f(
-            f_sub_f(
-                f_add_i(0, PRI_MAX),
-                f_div_i(t->recent_cpu, 4)
-                ), 
-            i_mul_f(2, f_add_i(0, t->nice))
-            ) / FRACTION;
-
-    if(t->priority < PRI_MIN) t->priority = PRI_MIN;
-    if(t->priority > PRI_MAX) t->priority = PRI_MAX;
+    t->base_priority = compute_priority(t);
+    t->priority = t->base_priority;
+    intr_set_level(old_level);
 
     if(t->priority < get_max_priority())
         thread_yield();
@@ -408,13 +681,20 @@ thread_get_nice (void) {
 /* Returns 100 times the system load average. */
     int
 thread_get_load_avg (void) {
-    return i_mul_f(100, load_avg) / FRACTION;
+    return f_to_i(i_mul_f(100, load_avg));
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
     int
 thread_get_recent_cpu (void) {
-    return i_mul_f(100, thread_current()->recent_cpu) / FRACTION;
+    enum intr_level old_level = intr_disable();
+    fixed_t recent_cpu;
+
+    decay_recent_cpu(thread_current());
+    recent_cpu = thread_current()->recent_cpu;
+    intr_set_level(old_level);
+
+    return f_to_i(i_mul_f(100, recent_cpu));
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -450,7 +730,11 @@ idle (void *idle_started_ UNUSED)
            time.
 
            See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-           7.11.1 "HLT Instruction". */
+           7.11.1 "HLT Instruction".
+
+           In tickless mode, first stretch the timer period to
+           cover the time until the next thread is due to wake. */
+        timer_idle_begin ();
         asm volatile ("sti; hlt" : : : "memory");
     }
 }
@@ -502,6 +786,8 @@ init_thread (struct thread *t, const char *name, int priority) {
     strlcpy (t->name, name, sizeof t->name);
     t->stack = (uint8_t *) t + PGSIZE;
     t->priority = priority;
+    t->base_priority = priority;
+    list_init (&t->held_locks);
     t->magic = THREAD_MAGIC;
 
     old_level = intr_disable ();
@@ -509,7 +795,9 @@ init_thread (struct thread *t, const char *name, int priority) {
     intr_set_level (old_level);
 
     t->recent_cpu = running_thread()->recent_cpu;
+    t->decay_epoch = running_thread()->decay_epoch;
     t->nice = running_thread()->nice;
+    t->dirty = false;
 
 #ifdef USERPROG
     t->parent = running_thread();
@@ -543,10 +831,15 @@ alloc_frame (struct thread *t, size_t size)
     static struct thread *
 next_thread_to_run (void) 
 {
-    if (list_empty (&ready_list))
+    struct thread *t;
+
+    if (ready_mask == 0)
         return idle_thread;
-    else
-        return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+    t = list_entry (list_front (&ready_lists[get_max_priority ()]),
+                    struct thread, elem);
+    ready_remove (t);
+    return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -575,6 +868,17 @@ thread_schedule_tail (struct thread *prev)
     /* Mark us as running. */
     cur->status = THREAD_RUNNING;
 
+    /* Account for the time we spent waiting to run. */
+    if (cur->ready_since != 0)
+    {
+        uint64_t cycles = rdtsc () - cur->ready_since;
+
+        cur->ready_cycles += cycles;
+        if (cur->woken)
+            wakeup_latency[latency_bucket (cycles)]++;
+        cur->ready_since = 0;
+    }
+
     /* Start new time slice. */
     thread_ticks = 0;
 
@@ -591,7 +895,7 @@ thread_schedule_tail (struct thread *prev)
     if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
         ASSERT (prev != cur);
-        palloc_free_page (prev);
+        free_thread (prev);
     }
 }
 
@@ -613,6 +917,10 @@ schedule (void)
     ASSERT (cur->status != THREAD_RUNNING);
     ASSERT (is_thread (next));
 
+    /* Restore the periodic tick if the idle thread stopped it. */
+    if (cur == idle_thread)
+        timer_idle_end ();
+
     if (cur != next)
         prev = switch_threads (cur, next);
     thread_schedule_tail (prev);
@@ -636,53 +944,63 @@ allocate_tid (void)
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
+/* Returns the highest priority of any ready thread, or -1 if no
+   thread is ready. */
 int get_max_priority(void) {
-    int priority = -1;
-    if(!list_empty(&ready_list)) {
-        priority = list_entry(list_front(&ready_list), struct thread, elem)->priority;
-    }
+    uint32_t high = ready_mask >> 32;
 
-    return priority;
+    if(ready_mask == 0)
+        return -1;
+    if(high != 0)
+        return 32 + highest_bit(high);
+    return highest_bit((uint32_t) ready_mask);
+}
+
+/* Charges the running thread for the current tick and continues
+   the decay sweep started by update_load_avg_recent_cpu().
+   Called from the timer interrupt on every tick. */
+void update_recent_cpu(void) {
+    struct thread* cur = thread_current();
+
+    if(cur != idle_thread) {
+        decay_recent_cpu(cur);
+        cur->recent_cpu = f_add_i(cur->recent_cpu, 1);
+        mark_dirty(cur);
+    }
+    decay_step(DECAY_BATCH);
 }
 
+/* Updates load_avg and starts decaying every thread's recent_cpu.
+   Called from the timer interrupt once per second. */
 void update_load_avg_recent_cpu(void) {
-    struct thread* t;
-    int ready_threads_num = list_size(&ready_list);
+    int ready_threads_num = ready_cnt;
 
     if(thread_current() != idle_thread)
         ready_threads_num++;
 
-    load_avg = f_div_i(f_add_i(i_mul_f(59, load_avg), ready_threads_num), 60);
-
-    for(struct list_elem* e = list_begin(&all_list);
-            e != list_end(&all_list);
-            e = list_next(e)) {
-        t = list_entry(e, struct thread, allelem);
-        if(idle_thread != t) {
-            t->recent_cpu = f_add_i(
-                    f_mul_f(
-                        f_div_f(
-                            i_mul_f(2, load_avg),
-                            f_add_i(i_mul_f(2, load_avg), 1)
-                            ), t->recent_cpu
-                        ), t->nice);
-        }
-    }
+    /* The previous sweep normally finished long ago, but it must
+       not overlap with the new one. */
+    decay_step(INT_MAX);
+
+    load_avg = f_add_f(f_mul_f(LOAD_AVG_DECAY, load_avg),
+                       i_mul_f(ready_threads_num, LOAD_AVG_WEIGHT));
+    decay_coef = f_div_f(i_mul_f(2, load_avg),
+                         f_add_i(i_mul_f(2, load_avg), 1));
+    decay_epoch++;
+    decay_cursor = list_begin(&all_list);
+    decay_step(DECAY_BATCH);
 }
 
+/* Recomputes the priority of every thread whose recent_cpu changed
+   since the last call.  Called from the timer interrupt every
+   PRIORITY_RECALC_FREQ ticks. */
 void update_priority(void) {
-    struct thread* t;
-    for(struct list_elem* e = list_begin(&all_list);
-            e != list_end(&all_list);
-            e = list_next(e)) {
-        t = list_entry(e, struct thread, allelem);
-        t->priority = f_sub_f(
-                f_sub_f(f_add_i(0, PRI_MAX), f_div_i(t->recent_cpu, 4)),
-                i_mul_f(2, f_add_i(0, t->nice))
-                ) / FRACTION;
-
-        if (t->priority > PRI_MAX) t->priority = PRI_MAX;
-        if (t->priority < PRI_MIN) t->priority = PRI_MIN;
+    while(!list_empty(&dirty_list)) {
+        struct thread* t = list_entry(list_pop_front(&dirty_list),
+                                      struct thread, dirty_elem);
+        t->dirty = false;
+        t->base_priority = compute_priority(t);
+        set_priority(t, t->base_priority);
     }
 
     if(thread_current()->priority < get_max_priority()) {
@@ -690,3 +1008,53 @@ void update_priority(void) {
     }
 }
 
+/* Applies the current second's decay to T's recent_cpu, unless T
+   already has it.  Interrupts must be off. */
+static void decay_recent_cpu(struct thread* t) {
+    if(t->decay_epoch == decay_epoch)
+        return;
+
+    /* A thread only misses one second's decay, because a sweep
+       always completes before the next one starts. */
+    t->recent_cpu = f_add_i(f_mul_f(decay_coef, t->recent_cpu), t->nice);
+    t->decay_epoch = decay_epoch;
+    mark_dirty(t);
+}
+
+/* Decays the recent_cpu of up to CNT more threads in the current
+   sweep.  Interrupts must be off. */
+static void decay_step(int cnt) {
+    while(decay_cursor != NULL && cnt-- > 0) {
+        struct thread* t;
+
+        if(decay_cursor == list_end(&all_list)) {
+            decay_cursor = NULL;
+            break;
+        }
+        t = list_entry(decay_cursor, struct thread, allelem);
+        decay_cursor = list_next(decay_cursor);
+        if(t != idle_thread)
+            decay_recent_cpu(t);
+    }
+}
+
+/* Queues T to have its priority recomputed by update_priority().
+   Interrupts must be off. */
+static void mark_dirty(struct thread* t) {
+    if(!t->dirty) {
+        t->dirty = true;
+        list_push_back(&dirty_list, &t->dirty_elem);
+    }
+}
+
+/* Returns T's priority under the MLFQS formula. */
+static int compute_priority(const struct thread* t) {
+    int priority = f_to_i(f_sub_i(
+            i_sub_f(PRI_MAX, f_div_i(t->recent_cpu, 4)),
+            2 * t->nice));
+
+    if (priority > PRI_MAX) priority = PRI_MAX;
+    if (priority < PRI_MIN) priority = PRI_MIN;
+    return priority;
+}
+
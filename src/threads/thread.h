@@ -2,7 +2,10 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
+#include <heap.h>
 #include <list.h>
+#include <schedstat.h>
 #include <stdint.h>
 #include "threads/synch.h"
 #include "threads/float_arith.h"
@@ -96,15 +99,36 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Priority, including donations. */
+    int base_priority;                  /* Priority without donations. */
     struct list_elem allelem;           /* List element for all threads list. */
 
+    /* CPU accounting, owned by thread.c. */
+    int64_t run_ticks;                  /* Timer ticks spent running. */
+    unsigned voluntary_cnt;             /* Times it blocked. */
+    unsigned involuntary_cnt;           /* Times it yielded while runnable. */
+    uint64_t ready_cycles;              /* CPU cycles spent ready to run. */
+    uint64_t ready_since;               /* TSC when made ready, or 0. */
+    bool woken;                         /* Made ready by thread_unblock()? */
+
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
-
-    int64_t wakeup_counter;
-    int recent_cpu;
+    struct heap_elem wait_elem;         /* Semaphore wait queue element. */
+    uint64_t wait_seq;                  /* Orders equal-priority waiters. */
+    struct semaphore *waiting_sema;     /* Semaphore being waited on. */
+    struct lock *waiting_lock;          /* Lock being waited on. */
+    struct list held_locks;             /* Locks held. */
+
+    /* Owned by devices/timer.c. */
+    struct heap_elem sleep_elem;        /* Sleep queue element. */
+    int64_t wakeup_counter;             /* Tick to wake up at. */
+    uint64_t sleep_seq;                 /* Orders equal wakeup ticks. */
+
+    fixed_t recent_cpu;                 /* Recent CPU time, for MLFQS. */
     int nice;
+    unsigned decay_epoch;               /* Last second of recent_cpu decay. */
+    struct list_elem dirty_elem;        /* Element in dirty list. */
+    bool dirty;                         /* Priority needs recomputing? */
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
@@ -117,6 +141,16 @@ struct thread
     struct semaphore load_lock;
     struct file* fd[MAX_FD_SIZE];
     struct thread* parent;
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct file *exec_file;             /* Executable, for lazy loading. */
+    void *user_esp;                     /* User %esp at system call entry. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mmaps;                  /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+#endif
 #endif
 
     /* Owned by thread.c. */
@@ -128,11 +162,17 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* Most freed thread pages kept for reuse.
+   Controlled by kernel command-line option "-tcache=N". */
+extern int thread_cache_max;
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+int thread_get_stats (struct thread_stat *, int max,
+                      uint64_t hist[SCHEDSTAT_BUCKETS]);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -160,6 +200,9 @@ int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
 int get_max_priority(void);
+void thread_donate_priority (struct thread *, int priority);
+void thread_refresh_priority (void);
+void update_recent_cpu(void);
 void update_load_avg_recent_cpu(void);
 void update_priority(void);
 
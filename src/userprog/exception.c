@@ -6,6 +6,9 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/syscall.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -150,6 +153,25 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* Bring in a page that was recorded but never loaded, or grow
+     the stack.  The kernel faults here too, when a system call
+     touches user memory, and then F->esp is the kernel's stack
+     pointer, so use the one saved at system call entry. */
+  if (not_present && is_user_vaddr (fault_addr)) 
+    {
+      void *esp = user ? f->esp : thread_current ()->user_esp;
+      if (page_fault_in (fault_addr) || page_grow_stack (fault_addr, esp))
+        return;
+    }
+
+  /* Copy a copy-on-write page on its first write.  CR0.WP makes
+     kernel writes to user memory fault here too. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_copy_on_write (fault_addr))
+    return;
+#endif
+
   if(!user || is_kernel_vaddr(fault_addr) || not_present)
       exit(-1);
 
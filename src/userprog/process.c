@@ -11,6 +11,7 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
@@ -22,6 +23,14 @@
 #include "lib/stdio.h"
 #include "threads/synch.h"
 #include "userprog/syscall.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* Statistics. */
+static long long load_cnt;              /* Executables loaded. */
+static long long load_cycles;           /* CPU cycles spent in load(). */
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
@@ -88,6 +97,7 @@ void parse_arg(const char* src, char* dest, char** next_ptr) {
 static void start_process (void *file_name_) {
     char *file_name = file_name_;
     struct intr_frame if_;
+    uint64_t start;
     bool success;
 
     /* Initialize interrupt frame and load executable. */
@@ -95,7 +105,10 @@ static void start_process (void *file_name_) {
     if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
     if_.cs = SEL_UCSEG;
     if_.eflags = FLAG_IF | FLAG_MBS;
+    start = rdtsc ();
     success = load (file_name, &if_.eip, &if_.esp);
+    load_cycles += rdtsc () - start;
+    load_cnt++;
 
     /* If load failed, quit. */
     palloc_free_page (file_name);
@@ -161,10 +174,22 @@ void process_exit (void) {
            directory before destroying the process's page
            directory, or our active page directory will be one
            that's been freed (and cleared). */
+#ifdef VM
+        /* Release frames while the page directory still maps
+           them, so that eviction never sees a torn-down process.
+           Unmapping files writes back their dirty pages. */
+        mmap_remove_all ();
+        page_table_destroy (&cur->pages);
+#endif
         cur->pagedir = NULL;
         pagedir_activate (NULL);
         pagedir_destroy (pd);
     }
+#ifdef VM
+    /* Closing the executable lets it be written again. */
+    file_close (cur->exec_file);
+    cur->exec_file = NULL;
+#endif
     sema_up(&(cur->child_mutex));
     sema_down(&(cur->mem_mutex));
 }
@@ -265,6 +290,12 @@ bool load (const char *file_name, void (**eip) (void), void **esp) {
     char* next_ptr;
 
     /* Allocate and activate page directory. */
+#ifdef VM
+    list_init (&t->mmaps);
+    t->next_mapid = 0;
+    if (!page_table_init (&t->pages))
+        goto done;
+#endif
     t->pagedir = pagedir_create ();
     if (t->pagedir == NULL) 
         goto done;
@@ -424,13 +455,31 @@ bool load (const char *file_name, void (**eip) (void), void **esp) {
 
 done:
     /* We arrive here whether the load is successful or not. */
+#ifdef VM
+    /* Pages are read from the executable lazily, so keep it open,
+       and unmodified, for as long as the process runs. */
+    if (file != NULL) 
+    {
+        file_deny_write (file);
+        t->exec_file = file;
+    }
+#else
     file_close (file);
+#endif
     return success;
 }
 
+/* Prints statistics about process loading. */
+void process_print_stats (void) {
+    printf ("Exec: %lld loads, %lld cycles/load\n",
+            load_cnt, load_cnt > 0 ? load_cycles / load_cnt : 0);
+}
+
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -497,7 +546,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
     ASSERT (pg_ofs (upage) == 0);
     ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
     file_seek (file, ofs);
+#endif
     while (read_bytes > 0 || zero_bytes > 0) 
     {
         /* Calculate how to fill this page.
@@ -506,6 +557,25 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
         size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
         size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+        /* Record where the page comes from.  page_fault() reads
+           it in when the process first touches it.  Every process
+           running this executable shares one frame for each
+           read-only page, and for each writable page until it
+           first writes to it. */
+        bool added;
+        if (page_read_bytes == 0)
+            added = page_add_zero (upage, writable);
+        else if (writable)
+            added = page_add_copy_on_write (upage, file, ofs,
+                    page_read_bytes);
+        else
+            added = page_add_shared (upage, file, ofs, page_read_bytes,
+                    false);
+        if (!added)
+            return false;
+        ofs += page_read_bytes;
+#else
         /* Get a page of memory. */
         uint8_t *kpage = palloc_get_page (PAL_USER);
         if (kpage == NULL)
@@ -525,6 +595,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
             palloc_free_page (kpage);
             return false; 
         }
+#endif
 
         /* Advance. */
         read_bytes -= page_read_bytes;
@@ -537,21 +608,30 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 /* Create a minimal stack by mapping a zeroed page at the top of
    user virtual memory. */
 static bool setup_stack (void **esp) {
+    void *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+#ifdef VM
+    if (!page_add_zero (upage, true) || !page_fault_in (upage))
+        return false;
+    *esp = PHYS_BASE;
+    return true;
+#else
     uint8_t *kpage;
     bool success = false;
 
     kpage = palloc_get_page (PAL_USER | PAL_ZERO);
     if (kpage != NULL) 
     {
-        success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
+        success = install_page (upage, kpage, true);
         if (success)
             *esp = PHYS_BASE;
         else
             palloc_free_page (kpage);
     }
     return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -569,3 +649,4 @@ static bool install_page (void *upage, void *kpage, bool writable) {
     return (pagedir_get_page (t->pagedir, upage) == NULL
             && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
@@ -13,6 +13,7 @@ int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
 void parse_arg(const char* src, char* dest, char** next_ptr);
+void process_print_stats (void);
 
 
 #endif /* userprog/process.h */
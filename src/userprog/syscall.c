@@ -4,6 +4,7 @@
 #include "lib/kernel/stdio.h"
 #include "lib/string.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/shutdown.h"
@@ -11,7 +12,9 @@
 #include "userprog/process.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
-#include "threads/synch.h"
+#ifdef VM
+#include "vm/mmap.h"
+#endif
 
 struct file {
     struct inode *inode;
@@ -19,16 +22,22 @@ struct file {
     bool deny_write;
 };
 
-struct lock file_lock;
-
 static void syscall_handler (struct intr_frame *);
+static int read_file (struct file *, void *, unsigned);
+static int write_file (struct file *, const void *, unsigned);
+static int read_stdin (void *, unsigned);
+static void user_buffer_check (const void *, unsigned, bool);
 
 void syscall_init (void) {
-    lock_init(&file_lock);
     intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
 static void syscall_handler (struct intr_frame *f UNUSED) {
+#ifdef VM
+    // page_fault() needs the user stack pointer to grow the stack
+    // when the kernel faults on user memory.
+    thread_current()->user_esp = f->esp;
+#endif
     switch(ESP_WORD(0)) {
         case SYS_HALT:      /* Halt the operating system. */
             halt();
@@ -112,6 +121,27 @@ static void syscall_handler (struct intr_frame *f UNUSED) {
                     ESP_WORD(4)
                     );
             break;
+        case SYS_SCHEDSTAT:
+            user_vaddr_check(_ESP(WORD_SIZE*1));
+            user_vaddr_check(_ESP(WORD_SIZE*2));
+            user_vaddr_check(_ESP(WORD_SIZE*3));
+            f->eax = schedstat(
+                    (struct thread_stat*)ESP_WORD(1),
+                    (int)ESP_WORD(2),
+                    (uint64_t*)ESP_WORD(3)
+                    );
+            break;
+#ifdef VM
+        case SYS_MMAP:      /* Map a file into memory. */
+            user_vaddr_check(_ESP(WORD_SIZE*1));
+            user_vaddr_check(_ESP(WORD_SIZE*2));
+            f->eax = mmap((int)ESP_WORD(1), (void*)ESP_WORD(2));
+            break;
+        case SYS_MUNMAP:    /* Remove a memory mapping. */
+            user_vaddr_check(_ESP(WORD_SIZE*1));
+            munmap((mapid_t)ESP_WORD(1));
+            break;
+#endif
         default: break;
     }
 }
@@ -159,8 +189,6 @@ int open(const char* file) {
     user_vaddr_check(file);
     if(!file) exit(-1);
 
-    lock_acquire(&file_lock);
-
     if((fp = filesys_open(file))) {
         for(int i = STDOUT_FILENO + 2 ; i < MAX_FD_SIZE ; i++) {
             if(!thread_current()->fd[i]) {
@@ -174,8 +202,6 @@ int open(const char* file) {
         }
     }
 
-    lock_release(&file_lock);
-
     return ret;
 }
 
@@ -191,22 +217,14 @@ int read(int fd, void* buffer, unsigned size) {
     if(!buffer){
         exit(-1);
     }
-    lock_acquire(&file_lock);
     // stdin
     if(fd == STDIN_FILENO) {
-        for(i = 0 ; i < (int)size ; i++) {
-            //buffer read
-            ((uint8_t*)buffer)[i] = input_getc();
-            if(((char*)buffer)[i] == '\0')
-                break;
-        }
+        i = read_stdin(buffer, size);
     } else if(fd > STDOUT_FILENO + 1) {
         if(!thread_current()->fd[fd]) exit(-1);
-        i = file_read(thread_current()->fd[fd], buffer, size);
+        i = read_file(thread_current()->fd[fd], buffer, size);
     }
 
-    lock_release(&file_lock);
-
     return i;
 }
 
@@ -215,7 +233,6 @@ int write(int fd, const void* buffer, unsigned size) {
     user_vaddr_check(buffer);
     if(!buffer) exit(-1);
 
-    lock_acquire(&file_lock);
     // stdout
     if(fd == STDOUT_FILENO) {
         putbuf(buffer, size);
@@ -226,13 +243,80 @@ int write(int fd, const void* buffer, unsigned size) {
         if(thread_current()->fd[fd]->deny_write) {
             file_deny_write(thread_current()->fd[fd]);
         }
-        ret = file_write(thread_current()->fd[fd], buffer, size);
+        ret = write_file(thread_current()->fd[fd], buffer, size);
     }
 
-    lock_release(&file_lock);
     return ret;
 }
 
+// Reads a line, or up to SIZE bytes of one, from the keyboard
+// into BUFFER.  Keys are taken under the input reader lock, where
+// a fault must not happen, so they go through a kernel page too.
+// As before, a null byte ends the read and is not counted.
+static int read_stdin(void* buffer, unsigned size) {
+    uint8_t* kbuf;
+    size_t n;
+
+    user_buffer_check(buffer, size, true);
+    if(size > PGSIZE) size = PGSIZE;
+    kbuf = palloc_get_page(0);
+    if(!kbuf) return -1;
+    n = input_read(kbuf, size);
+    memcpy(buffer, kbuf, n);
+    n = strnlen((const char*)kbuf, n);
+    palloc_free_page(kbuf);
+
+    return n;
+}
+
+// The file system must never touch user memory itself: a fault on
+// a user page while it holds the buffer cache lock would load the
+// page through the file system and take that lock again.  So file
+// data moves through a kernel page, and only these copies, made
+// with no file system lock held, touch the user's buffer.  The
+// buffer is checked before the page is taken, so that a bad one
+// kills the process without leaking it.
+static int read_file(struct file* fp, void* buffer, unsigned size) {
+    uint8_t* kbuf;
+    unsigned done = 0;
+
+    user_buffer_check(buffer, size, true);
+    kbuf = palloc_get_page(0);
+    if(!kbuf) return -1;
+    while(done < size) {
+        unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+        off_t n = file_read(fp, kbuf, chunk);
+
+        memcpy((uint8_t*)buffer + done, kbuf, n);
+        done += n;
+        if((unsigned)n < chunk) break;
+    }
+    palloc_free_page(kbuf);
+
+    return done;
+}
+
+static int write_file(struct file* fp, const void* buffer, unsigned size) {
+    uint8_t* kbuf;
+    unsigned done = 0;
+
+    user_buffer_check(buffer, size, false);
+    kbuf = palloc_get_page(0);
+    if(!kbuf) return -1;
+    while(done < size) {
+        unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+        off_t n;
+
+        memcpy(kbuf, (const uint8_t*)buffer + done, chunk);
+        n = file_write(fp, kbuf, chunk);
+        done += n;
+        if((unsigned)n < chunk) break;
+    }
+    palloc_free_page(kbuf);
+
+    return done;
+}
+
 void seek(int fd, unsigned position) {
     if(!thread_current()->fd[fd]) exit(-1);
     file_seek(thread_current()->fd[fd], position);
@@ -259,6 +343,28 @@ void user_vaddr_check(const void* vaddr) {
     }
 }
 
+// Touches every page of the SIZE bytes at BUFFER, for writing if
+// WRITABLE is true, so that a bad buffer kills the process here,
+// before the caller holds any kernel resource.  Pages of a good
+// buffer may still be evicted and fault back in later, but those
+// faults always succeed.
+static void user_buffer_check(const void* buffer, unsigned size,
+                              bool writable) {
+    volatile uint8_t* p = (volatile uint8_t*)buffer;
+    const uint8_t* end = (const uint8_t*)buffer + size;
+
+    if(size == 0) return;
+    if(end < (const uint8_t*)buffer) exit(-1);
+    user_vaddr_check(buffer);
+    user_vaddr_check(end - 1);
+    while((const uint8_t*)p < end) {
+        uint8_t byte = *p;
+        if(writable)
+            *p = byte;
+        p = (volatile uint8_t*)pg_round_down((const void*)p) + PGSIZE;
+    }
+}
+
 int max_of_four_int(int a, int b, int c, int d) {
     int max = a;
     if(max < b)
@@ -281,3 +387,49 @@ int fibonacci(int num) {
 
     return prev;
 }
+
+#ifdef VM
+mapid_t mmap(int fd, void* addr) {
+    if(fd <= STDOUT_FILENO || fd >= MAX_FD_SIZE || !thread_current()->fd[fd])
+        return MAP_FAILED;
+    return mmap_create(thread_current()->fd[fd], addr);
+}
+
+void munmap(mapid_t mapping) {
+    mmap_remove(mapping);
+}
+#endif
+
+/* Copies CPU accounting for up to MAX threads into STATS and, if
+   HIST is nonnull, the scheduling latency histogram into HIST.
+   Returns the number of threads copied. */
+int schedstat(struct thread_stat* stats, int max, uint64_t* hist) {
+    struct thread_stat* kstats;
+    uint64_t khist[SCHEDSTAT_BUCKETS];
+    int cnt;
+
+    if(max < 0) max = 0;
+    if(max > (int)(PGSIZE / sizeof *stats))
+        max = PGSIZE / sizeof *stats;
+    // Check both buffers before taking a page, which a fault on a
+    // bad one would otherwise leak.
+    if(max > 0) {
+        if(!stats) exit(-1);
+        user_buffer_check(stats, max * sizeof *stats, true);
+    }
+    if(hist)
+        user_buffer_check(hist, sizeof khist, true);
+
+    // Collect into kernel memory first: thread_get_stats() runs with
+    // interrupts off, where a fault on a user page is not allowed.
+    kstats = palloc_get_page(0);
+    if(!kstats) return -1;
+    cnt = thread_get_stats(kstats, max, khist);
+
+    memcpy(stats, kstats, cnt * sizeof *stats);
+    if(hist)
+        memcpy(hist, khist, sizeof khist);
+    palloc_free_page(kstats);
+
+    return cnt;
+}
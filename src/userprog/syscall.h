@@ -27,6 +27,11 @@ void user_vaddr_check(const void* vaddr);
 // Additional system calls
 int max_of_four_int(int a, int b, int c, int d);
 int fibonacci(int num);
+int schedstat(struct thread_stat* stats, int max, uint64_t* hist);
+#ifdef VM
+mapid_t mmap(int fd, void* addr);
+void munmap(mapid_t mapping);
+#endif
 
 
 #endif /* userprog/syscall.h */
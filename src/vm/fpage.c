@@ -0,0 +1,337 @@
+#include "vm/fpage.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* File page cache.  fpage_lock protects the table and every
+   fpage's REF_CNT, so that a shared page cannot be freed between
+   being found and being attached to. */
+static struct hash fpages;
+static struct lock fpage_lock;
+
+/* Statistics. */
+static long long load_cnt;              /* Pages read from files. */
+static long long share_cnt;             /* Mappings of pages already in. */
+static long long writeback_cnt;         /* Dirty pages written back. */
+static long long writeback_fail_cnt;    /* Write-backs that fell short. */
+
+static hash_hash_func fpage_hash;
+static hash_less_func fpage_less;
+static struct fpage *attach (struct page *);
+static bool load (struct fpage *);
+static bool write_back (struct fpage *);
+
+/* Initializes the file page cache. */
+void
+fpage_init (void) 
+{
+  if (!hash_init (&fpages, fpage_hash, fpage_less, NULL))
+    PANIC ("file page cache initialization failed");
+  lock_init (&fpage_lock);
+}
+
+/* Maps shared page P, which must not be mapped yet, into its
+   owner's address space, attaching P to the file page cache and
+   reading the data in as necessary.  P's lock must be held.
+   Returns true if successful, false on failure. */
+bool
+fpage_fault (struct page *p) 
+{
+  struct fpage *fp;
+  bool success;
+
+  ASSERT (p->type == PAGE_SHARED);
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  if (p->fpage == NULL) 
+    {
+      p->fpage = attach (p);
+      if (p->fpage == NULL)
+        return false;
+    }
+  fp = p->fpage;
+
+  /* Copy-on-write pages are mapped read-only until written. */
+  lock_acquire (&fp->lock);
+  if (fp->frame != NULL)
+    share_cnt++;
+  success = ((fp->frame != NULL || load (fp))
+             && pagedir_set_page (p->owner->pagedir, p->upage,
+                                  fp->frame->kpage,
+                                  p->writable && !p->copy_on_write));
+  lock_release (&fp->lock);
+  return success;
+}
+
+/* Copies the data of shared page P into KPAGE, reading it in
+   first if necessary.  P's lock must be held.  Returns true if
+   successful, false on failure. */
+bool
+fpage_copy (struct page *p, void *kpage) 
+{
+  struct fpage *fp;
+  bool success;
+
+  ASSERT (p->type == PAGE_SHARED);
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  if (p->fpage == NULL) 
+    {
+      p->fpage = attach (p);
+      if (p->fpage == NULL)
+        return false;
+    }
+  fp = p->fpage;
+
+  lock_acquire (&fp->lock);
+  success = fp->frame != NULL || load (fp);
+  if (success)
+    memcpy (kpage, fp->frame->kpage, PGSIZE);
+  lock_release (&fp->lock);
+  return success;
+}
+
+/* Unmaps shared page P and detaches it from the file page cache.
+   When the last page detaches, writes the data back if it is
+   dirty and frees the shared page.  P's lock must be held. */
+void
+fpage_detach (struct page *p) 
+{
+  struct fpage *fp = p->fpage;
+  uint32_t *pd = p->owner->pagedir;
+  bool last;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  if (fp == NULL)
+    return;
+
+  lock_acquire (&fp->lock);
+  if (pagedir_get_page (pd, p->upage) != NULL) 
+    {
+      fp->dirty |= pagedir_is_dirty (pd, p->upage);
+      pagedir_clear_page (pd, p->upage);
+    }
+  list_remove (&p->fpage_elem);
+  p->fpage = NULL;
+
+  lock_acquire (&fpage_lock);
+  last = --fp->ref_cnt == 0;
+  if (last)
+    hash_delete (&fpages, &fp->elem);
+  lock_release (&fpage_lock);
+
+  if (last && fp->frame != NULL) 
+    {
+      /* Nobody maps the page any more, so if it cannot be
+         written back, its changes are lost. */
+      if (fp->dirty)
+        write_back (fp);
+      frame_free (fp->frame);
+    }
+  lock_release (&fp->lock);
+
+  if (last) 
+    {
+      file_close (fp->file);
+      free (fp);
+    }
+}
+
+/* Returns true if any process accessed FP since the last call,
+   clearing the accessed bits.  FP's lock must be held. */
+bool
+fpage_test_and_clear_accessed (struct fpage *fp) 
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  ASSERT (lock_held_by_current_thread (&fp->lock));
+
+  for (e = list_begin (&fp->pages); e != list_end (&fp->pages);
+       e = list_next (e)) 
+    {
+      struct page *p = list_entry (e, struct page, fpage_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage)) 
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Unmaps FP from every process that maps it and writes it back
+   if it is dirty, leaving FP's frame, which must be pinned, free
+   for the caller to reuse.  FP's lock must be held.  Returns
+   true if successful, false if the write-back failed, in which
+   case FP keeps its frame and its mappings fault back in. */
+bool
+fpage_evict (struct fpage *fp) 
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&fp->lock));
+  ASSERT (fp->frame->pinned);
+
+  for (e = list_begin (&fp->pages); e != list_end (&fp->pages);
+       e = list_next (e)) 
+    {
+      struct page *p = list_entry (e, struct page, fpage_elem);
+      uint32_t *pd = p->owner->pagedir;
+      enum intr_level old_level;
+
+      /* As in page_evict(), no write may slip in between reading
+         the dirty bit and unmapping. */
+      old_level = intr_disable ();
+      if (pagedir_get_page (pd, p->upage) != NULL) 
+        {
+          fp->dirty |= pagedir_is_dirty (pd, p->upage);
+          pagedir_clear_page (pd, p->upage);
+        }
+      intr_set_level (old_level);
+    }
+
+  if (fp->dirty && !write_back (fp))
+    return false;
+  fp->frame = NULL;
+  return true;
+}
+
+/* Prints file page cache statistics. */
+void
+fpage_print_stats (void) 
+{
+  printf ("Shared pages: %lld loads, %lld shared mappings, "
+          "%lld write-backs, %lld failed\n",
+          load_cnt, share_cnt, writeback_cnt, writeback_fail_cnt);
+}
+
+/* Finds or creates the shared page for P's part of its file and
+   adds P to it.  Returns the shared page, or a null pointer if
+   memory allocation failed. */
+static struct fpage *
+attach (struct page *p) 
+{
+  struct fpage key, *fp;
+  struct hash_elem *e;
+
+  key.inode = file_get_inode (p->file);
+  key.ofs = p->ofs;
+  key.read_bytes = p->read_bytes;
+  key.writable = p->writable && !p->copy_on_write;
+
+  lock_acquire (&fpage_lock);
+  e = hash_find (&fpages, &key.elem);
+  if (e != NULL)
+    fp = hash_entry (e, struct fpage, elem);
+  else 
+    {
+      fp = malloc (sizeof *fp);
+      if (fp == NULL || (fp->file = file_reopen (p->file)) == NULL) 
+        {
+          lock_release (&fpage_lock);
+          free (fp);
+          return NULL;
+        }
+      fp->inode = key.inode;
+      fp->ofs = key.ofs;
+      fp->read_bytes = key.read_bytes;
+      fp->writable = key.writable;
+      fp->ref_cnt = 0;
+      fp->frame = NULL;
+      fp->dirty = false;
+      list_init (&fp->pages);
+      lock_init (&fp->lock);
+      hash_insert (&fpages, &fp->elem);
+    }
+  fp->ref_cnt++;
+  lock_release (&fpage_lock);
+
+  lock_acquire (&fp->lock);
+  list_push_back (&fp->pages, &p->fpage_elem);
+  lock_release (&fp->lock);
+  return fp;
+}
+
+/* Reads FP into a new frame.  FP's lock must be held.  Returns
+   true if successful, false on failure. */
+static bool
+load (struct fpage *fp) 
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&fp->lock));
+
+  f = frame_alloc_shared (fp);
+  if (f == NULL)
+    return false;
+  if (file_read_at (fp->file, f->kpage, fp->read_bytes, fp->ofs)
+      != (off_t) fp->read_bytes) 
+    {
+      frame_free (f);
+      return false;
+    }
+  memset ((uint8_t *) f->kpage + fp->read_bytes, 0, PGSIZE - fp->read_bytes);
+  fp->frame = f;
+  frame_unpin (f);
+  load_cnt++;
+  return true;
+}
+
+/* Writes dirty shared page FP back to its file.  FP's lock must
+   be held.  Returns true if successful, false if the file took
+   fewer bytes, for example because it is a running executable
+   and denies writes. */
+static bool
+write_back (struct fpage *fp) 
+{
+  ASSERT (lock_held_by_current_thread (&fp->lock));
+  ASSERT (fp->dirty && fp->frame != NULL);
+
+  if (file_write_at (fp->file, fp->frame->kpage, fp->read_bytes, fp->ofs)
+      != (off_t) fp->read_bytes) 
+    {
+      writeback_fail_cnt++;
+      return false;
+    }
+  fp->dirty = false;
+  writeback_cnt++;
+  return true;
+}
+
+/* Returns a hash value for the shared page containing hash
+   element E. */
+static unsigned
+fpage_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct fpage *fp = hash_entry (e, struct fpage, elem);
+  return hash_int ((int) fp->inode ^ fp->ofs);
+}
+
+/* Returns true if shared page A precedes shared page B. */
+static bool
+fpage_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct fpage *a = hash_entry (a_, struct fpage, elem);
+  const struct fpage *b = hash_entry (b_, struct fpage, elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  else if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  else if (a->read_bytes != b->read_bytes)
+    return a->read_bytes < b->read_bytes;
+  else
+    return a->writable < b->writable;
+}
@@ -0,0 +1,48 @@
+#ifndef VM_FPAGE_H
+#define VM_FPAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct page;
+
+/* A page of file data shared by every process that maps it.
+
+   File pages are kept in a cache keyed by inode and offset, so
+   that processes mapping the same part of the same file share a
+   single frame.  Writable mappings, whose stores go back to the
+   file, are keyed apart from read-only and copy-on-write ones,
+   such as executable pages, so that a store through one never
+   shows up in the other.  Each process still has its own struct page for
+   the mapping, of type PAGE_SHARED, which "attaches" to the
+   shared page. */
+struct fpage
+  {
+    /* Key. */
+    struct inode *inode;        /* File's inode. */
+    off_t ofs;                  /* Page-aligned offset in the file. */
+    size_t read_bytes;          /* Bytes from the file; the rest are 0. */
+    bool writable;              /* Mapped writable, written back? */
+
+    struct file *file;          /* For reading and writing back. */
+    int ref_cnt;                /* Attached pages, under the cache lock. */
+    struct frame *frame;        /* Frame holding the data, or null. */
+    bool dirty;                 /* Modified since last written back? */
+    struct list pages;          /* Attached struct page entries. */
+    struct lock lock;           /* Held while loading, mapping, evicting. */
+    struct hash_elem elem;      /* Element in the file page cache. */
+  };
+
+void fpage_init (void);
+bool fpage_fault (struct page *);
+void fpage_detach (struct page *);
+bool fpage_copy (struct page *, void *kpage);
+bool fpage_test_and_clear_accessed (struct fpage *);
+bool fpage_evict (struct fpage *);
+void fpage_print_stats (void);
+
+#endif /* vm/fpage.h */
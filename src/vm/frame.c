@@ -0,0 +1,242 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/fpage.h"
+#include "vm/page.h"
+
+/* Every frame holding a user page, in clock order. */
+static struct list frame_list;
+static struct list_elem *clock_hand;    /* Next frame to consider. */
+static struct lock frame_lock;
+
+/* Statistics. */
+static long long evict_cnt;             /* Frames evicted. */
+static long long evict_cycles;          /* CPU cycles spent evicting. */
+
+static struct frame *get_frame (bool zero);
+static struct frame *evict (void);
+static struct frame *clock_next (void);
+static bool try_lock (struct frame *);
+static void unlock (struct frame *);
+static bool test_and_clear_accessed (struct frame *);
+
+/* Initializes the frame table. */
+void
+frame_init (void) 
+{
+  list_init (&frame_list);
+  clock_hand = NULL;
+  lock_init (&frame_lock);
+}
+
+/* Returns a frame for PAGE, zeroed if ZERO is true, evicting
+   another page if the user pool is exhausted.  The frame is
+   pinned; the caller unpins it once PAGE is mapped.  Returns a
+   null pointer if no frame could be found. */
+struct frame *
+frame_alloc (struct page *page, bool zero) 
+{
+  struct frame *f = get_frame (zero);
+
+  if (f != NULL) 
+    {
+      f->owner = thread_current ();
+      f->page = page;
+      f->fpage = NULL;
+    }
+  return f;
+}
+
+/* Returns a pinned frame for shared page FPAGE, like
+   frame_alloc(). */
+struct frame *
+frame_alloc_shared (struct fpage *fpage) 
+{
+  struct frame *f = get_frame (false);
+
+  if (f != NULL) 
+    {
+      f->owner = NULL;
+      f->page = NULL;
+      f->fpage = fpage;
+    }
+  return f;
+}
+
+/* Frees frame F, which must no longer be mapped. */
+void
+frame_free (struct frame *f) 
+{
+  lock_acquire (&frame_lock);
+  if (clock_hand == &f->elem)
+    clock_hand = list_next (clock_hand);
+  list_remove (&f->elem);
+  lock_release (&frame_lock);
+
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Makes frame F eligible for eviction again. */
+void
+frame_unpin (struct frame *f) 
+{
+  f->pinned = false;
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void) 
+{
+  printf ("Frames: %zu in use, %lld evictions, %lld cycles/eviction\n",
+          list_size (&frame_list), evict_cnt,
+          evict_cnt > 0 ? evict_cycles / evict_cnt : 0);
+}
+
+/* Returns a pinned frame, zeroed if ZERO is true, evicting
+   another page if the user pool is exhausted, or a null pointer
+   if no frame could be found. */
+static struct frame *
+get_frame (bool zero) 
+{
+  struct frame *f;
+  void *kpage;
+
+  kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  if (kpage != NULL) 
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return NULL;
+        }
+      f->kpage = kpage;
+      f->pinned = true;
+      lock_acquire (&frame_lock);
+      list_push_back (&frame_list, &f->elem);
+      lock_release (&frame_lock);
+    }
+  else
+    {
+      f = evict ();
+      if (f == NULL)
+        return NULL;
+      if (zero)
+        memset (f->kpage, 0, PGSIZE);
+    }
+  return f;
+}
+
+/* Chooses a frame with the second-chance clock algorithm, writes
+   its page out, and returns it pinned.  Returns a null pointer if
+   every frame is pinned or busy, or if the page could not be
+   written out. */
+static struct frame *
+evict (void) 
+{
+  uint64_t start = rdtsc ();
+  struct frame *victim = NULL;
+  size_t i, n;
+
+  lock_acquire (&frame_lock);
+
+  /* The first pass around the clock may only clear accessed
+     bits, so allow two. */
+  n = 2 * list_size (&frame_list);
+  for (i = 0; i < n && victim == NULL; i++) 
+    {
+      struct frame *f = clock_next ();
+
+      /* Skip pages being brought in or torn down. */
+      if (f->pinned || !try_lock (f))
+        continue;
+      if (test_and_clear_accessed (f)) 
+        {
+          unlock (f);
+          continue;
+        }
+      f->pinned = true;
+      victim = f;
+    }
+
+  lock_release (&frame_lock);
+  if (victim == NULL)
+    return NULL;
+
+  /* Write out the page with only its own lock held, so that other
+     faults can proceed meanwhile. */
+  if (victim->fpage != NULL ? !fpage_evict (victim->fpage)
+      : !page_evict (victim->page)) 
+    {
+      victim->pinned = false;
+      unlock (victim);
+      return NULL;
+    }
+  unlock (victim);
+
+  lock_acquire (&frame_lock);
+  evict_cnt++;
+  evict_cycles += rdtsc () - start;
+  lock_release (&frame_lock);
+  return victim;
+}
+
+/* Returns the frame under the clock hand and advances the hand.
+   The frame list must not be empty.  frame_lock must be held. */
+static struct frame *
+clock_next (void) 
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (!list_empty (&frame_list));
+
+  if (clock_hand == NULL || clock_hand == list_end (&frame_list))
+    clock_hand = list_begin (&frame_list);
+  f = list_entry (clock_hand, struct frame, elem);
+  clock_hand = list_next (clock_hand);
+  return f;
+}
+
+/* Tries to acquire the lock of the page in frame F without
+   sleeping.  Returns true if successful, false otherwise. */
+static bool
+try_lock (struct frame *f) 
+{
+  return lock_try_acquire (f->fpage != NULL ? &f->fpage->lock
+                           : &f->page->lock);
+}
+
+/* Releases the lock of the page in frame F. */
+static void
+unlock (struct frame *f) 
+{
+  lock_release (f->fpage != NULL ? &f->fpage->lock : &f->page->lock);
+}
+
+/* Returns true if the page in frame F was accessed since the last
+   call, clearing its accessed bits.  The page's lock must be
+   held. */
+static bool
+test_and_clear_accessed (struct frame *f) 
+{
+  uint32_t *pd;
+
+  if (f->fpage != NULL)
+    return fpage_test_and_clear_accessed (f->fpage);
+
+  pd = f->owner->pagedir;
+  if (!pagedir_is_accessed (pd, f->page->upage))
+    return false;
+  pagedir_set_accessed (pd, f->page->upage, false);
+  return true;
+}
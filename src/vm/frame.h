@@ -0,0 +1,29 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+
+struct page;
+struct fpage;
+
+/* A frame of the user pool holding a user page, either private
+   to one process or shared through the file page cache. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct thread *owner;       /* Process a private page belongs to. */
+    struct page *page;          /* Private page held, or null. */
+    struct fpage *fpage;        /* Shared page held, or null. */
+    bool pinned;                /* Exempt from eviction? */
+    struct list_elem elem;      /* Element in frame list. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, bool zero);
+struct frame *frame_alloc_shared (struct fpage *);
+void frame_free (struct frame *);
+void frame_unpin (struct frame *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
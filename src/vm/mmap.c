@@ -0,0 +1,128 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+static struct mmap *lookup (mapid_t);
+static void unmap (struct mmap *);
+
+/* Maps FILE into the current process's address space starting
+   at page-aligned user address ADDR.  Pages are read lazily and
+   shared with other processes that map the same file.  Returns
+   the new mapping's identifier, or MAP_FAILED if FILE is empty,
+   ADDR is unsuitable, the mapping would overlap existing pages,
+   or memory allocation fails. */
+mapid_t
+mmap_create (struct file *file, void *addr) 
+{
+  struct thread *t = thread_current ();
+  struct mmap *m;
+  off_t length;
+  size_t i;
+
+  length = file_length (file);
+  if (length == 0 || addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen (file);
+  if (m->file == NULL) 
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  m->addr = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  /* Check the whole range before recording any of it. */
+  for (i = 0; i < m->page_cnt; i++) 
+    {
+      void *upage = (uint8_t *) addr + i * PGSIZE;
+      if (!is_user_vaddr (upage) || page_lookup (upage) != NULL)
+        goto fail;
+    }
+
+  for (i = 0; i < m->page_cnt; i++) 
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_shared ((uint8_t *) addr + ofs, m->file, ofs,
+                            read_bytes, true)) 
+        {
+          while (i-- > 0)
+            page_remove ((uint8_t *) addr + i * PGSIZE);
+          goto fail;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mmaps, &m->elem);
+  return m->id;
+
+ fail:
+  file_close (m->file);
+  free (m);
+  return MAP_FAILED;
+}
+
+/* Unmaps the current process's mapping MAPPING, writing back any
+   changes.  Returns true if successful, false if there is no
+   such mapping. */
+bool
+mmap_remove (mapid_t mapping) 
+{
+  struct mmap *m = lookup (mapping);
+
+  if (m == NULL)
+    return false;
+  unmap (m);
+  return true;
+}
+
+/* Unmaps all of the current process's mappings. */
+void
+mmap_remove_all (void) 
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mmaps))
+    unmap (list_entry (list_front (&t->mmaps), struct mmap, elem));
+}
+
+/* Returns the current process's mapping MAPPING, or a null
+   pointer if there is none. */
+static struct mmap *
+lookup (mapid_t mapping) 
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mmaps); e != list_end (&t->mmaps);
+       e = list_next (e)) 
+    {
+      struct mmap *m = list_entry (e, struct mmap, elem);
+      if (m->id == mapping)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes M's pages and frees M. */
+static void
+unmap (struct mmap *m) 
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove ((uint8_t *) m->addr + i * PGSIZE);
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
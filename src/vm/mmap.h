@@ -0,0 +1,22 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stddef.h>
+#include "lib/user/syscall.h"
+
+/* A file mapped into a process's address space. */
+struct mmap
+  {
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Mapped file, reopened. */
+    void *addr;                 /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+    struct list_elem elem;      /* Element in thread's mmaps list. */
+  };
+
+mapid_t mmap_create (struct file *, void *addr);
+bool mmap_remove (mapid_t);
+void mmap_remove_all (void);
+
+#endif /* vm/mmap.h */
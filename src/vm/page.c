@@ -0,0 +1,416 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/fpage.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Most pages a user stack may grow to.  8 MB by default. */
+size_t stack_max_pages = 2048;
+
+/* Extra pages mapped below a stack page faulted in by growth,
+   so that deep recursion takes fewer faults.  0 by default. */
+size_t stack_prefault_pages = 0;
+
+/* Bytes below the stack pointer that a push may touch before
+   adjusting it.  PUSHA stores 32 bytes below %esp. */
+#define STACK_SLOP 32
+
+/* Statistics. */
+static long long zero_page_cnt;         /* Pages zero-filled. */
+static long long stack_page_cnt;        /* Pages added by stack growth. */
+static long long cow_page_cnt;          /* Pages copied on write. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static void page_free (struct hash_elem *, void *aux);
+static struct page *page_add (void *upage, enum page_type, bool writable);
+static bool page_load (struct page *);
+
+/* Initializes PAGES as an empty supplemental page table.
+   Returns true if successful, false if memory allocation
+   failed. */
+bool
+page_table_init (struct hash *pages) 
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Frees every entry in PAGES, along with the frames and swap
+   slots that hold them.  PAGES must belong to the current
+   process, whose page directory must still be in place. */
+void
+page_table_destroy (struct hash *pages) 
+{
+  hash_destroy (pages, page_free);
+}
+
+/* Records that UPAGE in the current process is to be zero-filled
+   when it is first touched.  Returns true if successful, false
+   if UPAGE is already recorded or memory allocation failed. */
+bool
+page_add_zero (void *upage, bool writable) 
+{
+  return page_add (upage, PAGE_ZERO, writable) != NULL;
+}
+
+/* Records that UPAGE in the current process maps READ_BYTES
+   bytes of FILE starting at offset OFS, followed by zeros,
+   sharing the frame with every other process that maps the same
+   bytes.  Changes are written back to FILE.  Nothing is read
+   until the page is first touched.  Returns true if successful,
+   false if UPAGE is already recorded or memory allocation
+   failed. */
+bool
+page_add_shared (void *upage, struct file *file, off_t ofs,
+                 size_t read_bytes, bool writable) 
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = page_add (upage, PAGE_SHARED, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Records that UPAGE in the current process holds READ_BYTES
+   bytes of FILE starting at offset OFS, followed by zeros, and is
+   writable but private.  Until the process first writes the page,
+   it shares a read-only frame with every other process that maps
+   the same bytes; the write then copies the page.  FILE is never
+   written.  Returns true if successful, false if UPAGE is already
+   recorded or memory allocation failed. */
+bool
+page_add_copy_on_write (void *upage, struct file *file, off_t ofs,
+                        size_t read_bytes) 
+{
+  struct page *p;
+
+  if (!page_add_shared (upage, file, ofs, read_bytes, true))
+    return false;
+  p = page_lookup (upage);
+  p->copy_on_write = true;
+  return true;
+}
+
+/* Removes UPAGE from the current process's address space, which
+   must contain it, writing back shared data as necessary. */
+void
+page_remove (void *upage) 
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (&t->pages, &p->elem);
+  page_free (&p->elem, NULL);
+}
+
+/* Returns the current process's page containing ADDR, or a null
+   pointer if there is none. */
+struct page *
+page_lookup (const void *addr) 
+{
+  struct thread *t = thread_current ();
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = pg_round_down (addr);
+  e = hash_find (&t->pages, &key.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Brings in the current process's page containing ADDR, which
+   must not be present.  Returns true if successful, false if
+   ADDR is not in a recorded page or the page could not be
+   loaded. */
+bool
+page_fault_in (const void *addr) 
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+  bool success;
+
+  if (t->pagedir == NULL)
+    return false;
+  p = page_lookup (addr);
+  if (p == NULL)
+    return false;
+
+  lock_acquire (&p->lock);
+  if (p->type == PAGE_SHARED)
+    success = (pagedir_get_page (t->pagedir, p->upage) != NULL
+               || fpage_fault (p));
+  else
+    success = p->frame != NULL || page_load (p);
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Grows the current process's stack to cover ADDR, if ADDR
+   looks like a stack access given user stack pointer ESP: no
+   more than STACK_SLOP bytes below ESP and within
+   stack_max_pages of the top of user memory.  Also maps up to
+   stack_prefault_pages more pages below.  Returns true if ADDR
+   is now mapped, false otherwise. */
+bool
+page_grow_stack (const void *addr, const void *esp) 
+{
+  size_t max_pages = stack_max_pages;
+  uint8_t *stack_bottom;
+  uint8_t *upage = pg_round_down (addr);
+  size_t i;
+
+  if (max_pages > pg_no (PHYS_BASE) - 1)
+    max_pages = pg_no (PHYS_BASE) - 1;
+  stack_bottom = (uint8_t *) PHYS_BASE - max_pages * PGSIZE;
+
+  if (thread_current ()->pagedir == NULL
+      || (const uint8_t *) addr < stack_bottom
+      || !is_user_vaddr (addr)
+      || (const uint8_t *) addr + STACK_SLOP < (const uint8_t *) esp)
+    return false;
+
+  if (!page_add_zero (upage, true) || !page_fault_in (upage))
+    return false;
+  stack_page_cnt++;
+
+  for (i = 0; i < stack_prefault_pages; i++) 
+    {
+      upage -= PGSIZE;
+      if (upage < stack_bottom || page_lookup (upage) != NULL
+          || !page_add_zero (upage, true) || !page_fault_in (upage))
+        break;
+      stack_page_cnt++;
+    }
+  return true;
+}
+
+/* Gives the current process a private, writable copy of its
+   copy-on-write page containing ADDR, which must be mapped
+   read-only.  Returns true if successful, false if ADDR is not in
+   a copy-on-write page or memory is exhausted. */
+bool
+page_copy_on_write (const void *addr) 
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+  struct frame *f;
+  bool success = false;
+
+  if (t->pagedir == NULL)
+    return false;
+  p = page_lookup (addr);
+  if (p == NULL || p->type != PAGE_SHARED || !p->copy_on_write)
+    return false;
+
+  lock_acquire (&p->lock);
+  f = frame_alloc (p, false);
+  if (f != NULL) 
+    {
+      if (fpage_copy (p, f->kpage)) 
+        {
+          /* The page now exists only in memory, so from here on it
+             is evicted to swap like any page read back from
+             there. */
+          fpage_detach (p);
+          p->type = PAGE_SWAP;
+          p->copy_on_write = false;
+          if (pagedir_set_page (t->pagedir, p->upage, f->kpage, true)) 
+            {
+              p->frame = f;
+              frame_unpin (f);
+              cow_page_cnt++;
+              success = true;
+            }
+          else 
+            {
+              /* Fall back to sharing; the next fault reattaches. */
+              p->type = PAGE_SHARED;
+              p->copy_on_write = true;
+            }
+        }
+      if (!success)
+        frame_free (f);
+    }
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Unmaps page P from its owner's address space, writing it to
+   swap unless it can be brought back from its file or zeroed
+   again.  P's lock must be held and P must be in a pinned frame,
+   which the caller may reuse on success.  Returns true if
+   successful, false if swap is full, in which case P stays
+   mapped. */
+bool
+page_evict (struct page *p) 
+{
+  struct frame *f = p->frame;
+  uint32_t *pd = f->owner->pagedir;
+  enum intr_level old_level;
+  bool dirty;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->type != PAGE_SHARED);
+  ASSERT (f->pinned);
+
+  /* Unmap the page before writing it out, so that the owner
+     faults and waits on P's lock instead of changing it.  Keep
+     interrupts off so that no write slips in between reading the
+     dirty bit and unmapping. */
+  old_level = intr_disable ();
+  dirty = pagedir_is_dirty (pd, p->upage);
+  pagedir_clear_page (pd, p->upage);
+  intr_set_level (old_level);
+
+  /* A page already read back from swap exists nowhere else. */
+  if (dirty || p->type == PAGE_SWAP) 
+    {
+      size_t slot = swap_out (f->kpage);
+      if (slot == SWAP_ERROR) 
+        {
+          pagedir_set_page (pd, p->upage, f->kpage, p->writable);
+          pagedir_set_dirty (pd, p->upage, dirty);
+          return false;
+        }
+      p->type = PAGE_SWAP;
+      p->swap_slot = slot;
+    }
+  p->frame = NULL;
+  return true;
+}
+
+/* Prints paging statistics. */
+void
+page_print_stats (void) 
+{
+  printf ("Paging: %lld pages zero-filled, %lld stack pages added, "
+          "%lld pages copied on write\n",
+          zero_page_cnt, stack_page_cnt, cow_page_cnt);
+}
+
+/* Adds a page of the given TYPE at UPAGE to the current
+   process's page table and returns it, or returns a null pointer
+   if UPAGE is already recorded or memory allocation failed. */
+static struct page *
+page_add (void *upage, enum page_type type, bool writable) 
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->type = type;
+  p->writable = writable;
+  p->owner = t;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  p->frame = NULL;
+  p->swap_slot = SWAP_ERROR;
+  p->copy_on_write = false;
+  p->fpage = NULL;
+  lock_init (&p->lock);
+  if (hash_insert (&t->pages, &p->elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Reads page P into a new frame and maps it.  P's lock must be
+   held.  Returns true if successful, false on failure. */
+static bool
+page_load (struct page *p) 
+{
+  struct thread *t = thread_current ();
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  f = frame_alloc (p, p->type == PAGE_ZERO);
+  if (f == NULL)
+    return false;
+
+  switch (p->type) 
+    {
+    case PAGE_ZERO:
+      zero_page_cnt++;
+      break;
+
+    case PAGE_SWAP:
+      swap_in (p->swap_slot, f->kpage);
+      p->swap_slot = SWAP_ERROR;
+      break;
+
+    case PAGE_SHARED:
+      NOT_REACHED ();
+    }
+
+  if (!pagedir_set_page (t->pagedir, p->upage, f->kpage, p->writable))
+    {
+      frame_free (f);
+      return false;
+    }
+  p->frame = f;
+  frame_unpin (f);
+  return true;
+}
+
+/* Returns a hash value for the page containing hash element E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_int (pg_no (p->upage));
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED) 
+{
+  return (hash_entry (a, struct page, elem)->upage
+          < hash_entry (b, struct page, elem)->upage);
+}
+
+/* Frees the page containing hash element E, with its frame or
+   swap slot. */
+static void
+page_free (struct hash_elem *e, void *aux UNUSED) 
+{
+  struct page *p = hash_entry (e, struct page, elem);
+
+  /* Waits out an eviction in progress. */
+  lock_acquire (&p->lock);
+  if (p->type == PAGE_SHARED)
+    fpage_detach (p);
+  else if (p->frame != NULL) 
+    {
+      pagedir_clear_page (thread_current ()->pagedir, p->upage);
+      frame_free (p->frame);
+    }
+  else if (p->swap_slot != SWAP_ERROR)
+    swap_free (p->swap_slot);
+  lock_release (&p->lock);
+  free (p);
+}
@@ -0,0 +1,69 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+/* Stack growth tunables.  See page.c for details. */
+extern size_t stack_max_pages;
+extern size_t stack_prefault_pages;
+
+/* Where a page's contents come from the first time it is
+   touched. */
+enum page_type
+  {
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_SWAP,                  /* Swap, once the page has been evicted. */
+    PAGE_SHARED                 /* A file page shared through vm/fpage.c. */
+  };
+
+/* A user page in a process's supplemental page table.
+
+   The page table (the page directory) only describes pages that
+   are present in memory.  This table describes every page the
+   process may touch, so that the page fault handler can bring a
+   page in on first use. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    enum page_type type;        /* Source of the page's contents. */
+    bool writable;              /* Writable by the process? */
+    struct thread *owner;       /* Process the page belongs to. */
+    struct frame *frame;        /* Private frame holding the page, if any. */
+    struct lock lock;           /* Held while loading or evicting. */
+
+    /* PAGE_SHARED only. */
+    struct file *file;          /* File to read from. */
+    off_t ofs;                  /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read; the rest are zeroed. */
+
+    /* PAGE_SWAP only. */
+    size_t swap_slot;           /* Swap slot, or SWAP_ERROR if present. */
+
+    /* PAGE_SHARED only. */
+    bool copy_on_write;         /* Copy to a private frame on write? */
+    struct fpage *fpage;        /* Shared page attached to, if any. */
+    struct list_elem fpage_elem; /* Element in FPAGE's list of pages. */
+
+    struct hash_elem elem;      /* Element in the thread's page table. */
+  };
+
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_shared (void *upage, struct file *, off_t, size_t read_bytes,
+                      bool writable);
+bool page_add_copy_on_write (void *upage, struct file *, off_t,
+                             size_t read_bytes);
+void page_remove (void *upage);
+struct page *page_lookup (const void *addr);
+bool page_fault_in (const void *addr);
+bool page_evict (struct page *);
+bool page_grow_stack (const void *addr, const void *esp);
+bool page_copy_on_write (const void *addr);
+void page_print_stats (void);
+
+#endif /* vm/page.h */
@@ -0,0 +1,90 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Sectors in one page-sized swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* The swap device, divided into page-sized slots. */
+static struct block *swap_device;
+
+/* Slots in use, one bit per slot. */
+static struct bitmap *swap_slots;
+static struct lock swap_lock;
+
+/* Statistics. */
+static long long swap_in_cnt;           /* Pages read back in. */
+static long long swap_out_cnt;          /* Pages written out. */
+
+/* Initializes the swap area.  Without a swap device, every
+   swap_out() fails. */
+void
+swap_init (void) 
+{
+  size_t slot_cnt = 0;
+
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / SECTORS_PER_SLOT;
+  swap_slots = bitmap_create (slot_cnt);
+  if (swap_slots == NULL)
+    PANIC ("swap bitmap creation failed--swap device is too large");
+  lock_init (&swap_lock);
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot, or SWAP_ERROR if swap is full. */
+size_t
+swap_out (const void *kpage) 
+{
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_slots, 0, 1, false);
+  if (slot != BITMAP_ERROR)
+    swap_out_cnt++;
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_ERROR;
+
+  block_write_multiple (swap_device, slot * SECTORS_PER_SLOT,
+                        SECTORS_PER_SLOT, kpage);
+  return slot;
+}
+
+/* Reads the page in swap SLOT into KPAGE and frees the slot. */
+void
+swap_in (size_t slot, void *kpage) 
+{
+  block_read_multiple (swap_device, slot * SECTORS_PER_SLOT,
+                       SECTORS_PER_SLOT, kpage);
+  swap_free (slot);
+
+  lock_acquire (&swap_lock);
+  swap_in_cnt++;
+  lock_release (&swap_lock);
+}
+
+/* Frees swap SLOT without reading it. */
+void
+swap_free (size_t slot) 
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_slots, slot));
+  bitmap_reset (swap_slots, slot);
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void) 
+{
+  printf ("Swap: %lld pages in, %lld pages out, %zu of %zu slots in use\n",
+          swap_in_cnt, swap_out_cnt,
+          bitmap_count (swap_slots, 0, bitmap_size (swap_slots), true),
+          bitmap_size (swap_slots));
+}